@@ -0,0 +1,211 @@
+//
+// Copyright (c) 2016 Dado Colussi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+
+#ifndef __gdc__batch_tuner__
+#define __gdc__batch_tuner__
+
+
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+
+#include "gdc_clock.hpp"
+#include "gdc_framed_queue.hpp"
+
+
+namespace gdc
+{
+
+	struct batch_limits
+	{
+		batch_limits() :
+			min_batch(1),
+			max_batch(64),
+			max_delay_ns(20000),
+			interval_ns(1000000),
+			high_water(0.5)
+		{
+		}
+
+		std::size_t min_batch;
+		std::size_t max_batch;
+
+		// Longest time a committed record may be held back by batching.
+		std::uint64_t max_delay_ns;
+
+		// How often batch sizes are recomputed.
+		std::uint64_t interval_ns;
+
+		// Occupancy, as a fraction of capacity, above which the consumer
+		// is considered to lag behind.
+		double high_water;
+	};
+
+
+	// Tunes the publish batch of a producer's framed queue from its commit
+	// rate and the queue occupancy. The batch is the largest that fills
+	// within max_delay_ns at the measured rate, so light traffic is
+	// published record by record. When the consumer lags behind records
+	// wait in the queue anyway, so batches go to max_batch to cut the
+	// coherence traffic on the write position.
+	template<typename Q>
+	class publish_tuner
+	{
+	public:
+
+		typedef std::size_t size_type;
+
+
+		explicit publish_tuner(framed_queue<Q>& fq, const batch_limits& limits = batch_limits()) :
+			_fq(fq),
+			_limits(limits),
+			_last_time(clock_ns()),
+			_last_count(fq.records_committed())
+		{
+			_fq.set_publish_batch(_limits.min_batch);
+		}
+
+
+		// Call from the producer loop, also when it is idle. Publishes
+		// records held back longer than max_delay_ns.
+		void poll(std::uint64_t now = clock_ns())
+		{
+			if (_fq.unpublished() > 0 && now - _fq.unpublished_since() >= _limits.max_delay_ns)
+			{
+				_fq.publish();
+			}
+
+			if (now - _last_time >= _limits.interval_ns)
+			{
+				tune(now);
+			}
+		}
+
+
+		size_type batch() const noexcept
+		{
+			return _fq.publish_batch();
+		}
+
+
+	private:
+
+		void tune(std::uint64_t now)
+		{
+			auto elapsed = now - _last_time;
+
+			if (elapsed == 0)
+			{
+				// No rate to measure within one clock tick.
+				return;
+			}
+
+			auto n = _fq.records_committed() - _last_count;
+			auto rate = static_cast<double>(n) / elapsed;
+			auto b = static_cast<size_type>(rate * _limits.max_delay_ns);
+			auto& q = _fq.queue();
+			auto occupancy = static_cast<double>(q.available()) / q.capacity();
+
+			if (occupancy > _limits.high_water)
+			{
+				b = _limits.max_batch;
+			}
+
+			b = std::max(_limits.min_batch, std::min(_limits.max_batch, b));
+			_fq.set_publish_batch(b);
+			_last_time = now;
+			_last_count = _fq.records_committed();
+		}
+
+
+		framed_queue<Q>& _fq;
+		batch_limits _limits;
+		std::uint64_t _last_time;
+		std::uint64_t _last_count;
+
+	};
+
+
+	// Tunes the release batch of a consumer's framed queue from the queue
+	// occupancy. Releasing late adds no latency, it only keeps space from
+	// the producer: the batch doubles while occupancy stays below
+	// high_water and halves above it.
+	template<typename Q>
+	class release_tuner
+	{
+	public:
+
+		typedef std::size_t size_type;
+
+
+		explicit release_tuner(framed_queue<Q>& fq, const batch_limits& limits = batch_limits()) :
+			_fq(fq),
+			_limits(limits),
+			_last_time(clock_ns())
+		{
+			_fq.set_release_batch(_limits.min_batch);
+		}
+
+
+		// Call from the consumer loop.
+		void poll(std::uint64_t now = clock_ns())
+		{
+			if (now - _last_time >= _limits.interval_ns)
+			{
+				tune(now);
+			}
+		}
+
+
+		size_type batch() const noexcept
+		{
+			return _fq.release_batch();
+		}
+
+
+	private:
+
+		void tune(std::uint64_t now)
+		{
+			auto& q = _fq.queue();
+			auto occupancy = static_cast<double>(q.available()) / q.capacity();
+			auto b = _fq.release_batch();
+			b = occupancy > _limits.high_water ? b / 2 : b * 2;
+			b = std::max(_limits.min_batch, std::min(_limits.max_batch, b));
+			_fq.set_release_batch(b);
+			_last_time = now;
+		}
+
+
+		framed_queue<Q>& _fq;
+		batch_limits _limits;
+		std::uint64_t _last_time;
+
+	};
+
+}
+
+
+#endif
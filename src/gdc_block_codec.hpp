@@ -0,0 +1,420 @@
+//
+// Copyright (c) 2016 Dado Colussi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+#ifndef __gdc__block_codec__
+#define __gdc__block_codec__
+
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+
+namespace gdc
+{
+
+	// Compresses blocks of bytes on their way to and from disk.
+	class block_codec
+	{
+	public:
+
+		typedef std::size_t size_type;
+
+
+		// Returned by decompress() for corrupt input or a short output
+		// buffer. An empty block decompresses to 0 bytes.
+		static const size_type decompress_error = static_cast<size_type>(-1);
+
+
+		virtual ~block_codec() = default;
+
+
+		// Identifies the codec in journal block headers.
+		virtual std::uint32_t id() const noexcept = 0;
+
+
+		// Upper bound of compress() output for n input bytes.
+		virtual size_type max_compressed_size(size_type n) const noexcept = 0;
+
+
+		// Upper bound of decompress() output for n input bytes, so that
+		// readers can reject a corrupt size before allocating for it.
+		// Unbounded unless the codec knows better.
+		virtual size_type max_decompressed_size(size_type n) const noexcept
+		{
+			(void)n;
+			return static_cast<size_type>(-1);
+		}
+
+
+		// Compresses n bytes from in to out. Returns the compressed size, or
+		// 0 if out is too small.
+		virtual size_type compress(
+			const void* in,
+			size_type n,
+			void* out,
+			size_type capacity) const noexcept = 0;
+
+
+		// Decompresses n bytes from in to out. Returns the decompressed
+		// size, or decompress_error if the input is corrupt or out is too
+		// small.
+		virtual size_type decompress(
+			const void* in,
+			size_type n,
+			void* out,
+			size_type capacity) const noexcept = 0;
+
+	};
+
+
+	// Stores blocks as they are.
+	class null_codec : public block_codec
+	{
+	public:
+
+		static const std::uint32_t codec_id = 0;
+
+
+		std::uint32_t id() const noexcept override
+		{
+			return codec_id;
+		}
+
+
+		size_type max_compressed_size(size_type n) const noexcept override
+		{
+			return n;
+		}
+
+
+		size_type compress(
+			const void* in,
+			size_type n,
+			void* out,
+			size_type capacity) const noexcept override
+		{
+			if (n > capacity)
+			{
+				return 0;
+			}
+
+			std::memcpy(out, in, n);
+			return n;
+		}
+
+
+		size_type max_decompressed_size(size_type n) const noexcept override
+		{
+			return n;
+		}
+
+
+		size_type decompress(
+			const void* in,
+			size_type n,
+			void* out,
+			size_type capacity) const noexcept override
+		{
+			if (n > capacity)
+			{
+				return decompress_error;
+			}
+
+			std::memcpy(out, in, n);
+			return n;
+		}
+
+	};
+
+
+	// Byte oriented LZ77 codec in the spirit of LZ4.
+	//
+	// The output is a sequence of
+	//
+	// token | literal length... | literals | offset | match length...
+	//
+	// where the high nibble of the token is the literal length and the low
+	// nibble is the match length minus min_match. A nibble of 15 is
+	// followed by bytes adding up to the rest of the length, ending with a
+	// byte less than 255. The offset is 16-bit little endian. The last
+	// sequence has literals only.
+	class lz_codec : public block_codec
+	{
+	public:
+
+		static const std::uint32_t codec_id = 1;
+
+
+		std::uint32_t id() const noexcept override
+		{
+			return codec_id;
+		}
+
+
+		size_type max_compressed_size(size_type n) const noexcept override
+		{
+			return n + n / 255 + 16;
+		}
+
+
+		// Literals take one input byte each. A match takes at least three,
+		// and each of its length bytes adds at most 255 bytes of output.
+		size_type max_decompressed_size(size_type n) const noexcept override
+		{
+			return n > static_cast<size_type>(-1) / 255 ? static_cast<size_type>(-1) : n * 255;
+		}
+
+
+		size_type compress(
+			const void* in,
+			size_type n,
+			void* out,
+			size_type capacity) const noexcept override
+		{
+			if (capacity < max_compressed_size(n))
+			{
+				return 0;
+			}
+
+			auto begin = static_cast<const unsigned char*>(in);
+			auto end = begin + n;
+			auto ip = begin;
+			auto anchor = begin;
+			auto op = static_cast<unsigned char*>(out);
+			std::uint32_t table[hash_size] = {};
+
+			while (n >= min_match && ip <= end - min_match)
+			{
+				auto h = hash(read32(ip));
+				auto ref = begin + table[h];
+				table[h] = static_cast<std::uint32_t>(ip - begin);
+
+				if (ref >= ip || ip - ref > max_offset || read32(ref) != read32(ip))
+				{
+					++ip;
+					continue;
+				}
+
+				size_type len = min_match;
+				while (ip + len < end && ref[len] == ip[len])
+				{
+					++len;
+				}
+
+				op = put_sequence(op, anchor, ip - anchor, ip - ref, len);
+				ip += len;
+				anchor = ip;
+			}
+
+			auto token = op++;
+			*token = 0;
+			op = put_literals(op, token, anchor, end - anchor);
+			return op - static_cast<unsigned char*>(out);
+		}
+
+
+		size_type decompress(
+			const void* in,
+			size_type n,
+			void* out,
+			size_type capacity) const noexcept override
+		{
+			auto ip = static_cast<const unsigned char*>(in);
+			auto iend = ip + n;
+			auto begin = static_cast<unsigned char*>(out);
+			auto op = begin;
+			auto oend = begin + capacity;
+
+			while (ip < iend)
+			{
+				unsigned token = *ip++;
+				size_type lit = token >> 4;
+
+				if (lit == 15 && !get_length(ip, iend, lit))
+				{
+					return decompress_error;
+				}
+
+				if (lit > size_type(iend - ip) || lit > size_type(oend - op))
+				{
+					return decompress_error;
+				}
+
+				std::memcpy(op, ip, lit);
+				ip += lit;
+				op += lit;
+
+				if (ip == iend)
+				{
+					// Last sequence.
+					break;
+				}
+
+				if (iend - ip < 2)
+				{
+					return decompress_error;
+				}
+
+				size_type offset = ip[0] | (ip[1] << 8);
+				ip += 2;
+				size_type len = token & 15;
+
+				if (len == 15 && !get_length(ip, iend, len))
+				{
+					return decompress_error;
+				}
+
+				len += min_match;
+
+				if (offset == 0 || offset > size_type(op - begin) || len > size_type(oend - op))
+				{
+					return decompress_error;
+				}
+
+				// Matches may overlap their own output.
+				auto ref = op - offset;
+				for (size_type i = 0; i < len; ++i)
+				{
+					op[i] = ref[i];
+				}
+
+				op += len;
+			}
+
+			return op - begin;
+		}
+
+	private:
+
+		static const size_type min_match = 4;
+		static const std::ptrdiff_t max_offset = 65535;
+		static const unsigned hash_bits = 12;
+		static const unsigned hash_size = 1u << hash_bits;
+
+
+		static std::uint32_t read32(const unsigned char* p) noexcept
+		{
+			std::uint32_t v;
+			std::memcpy(&v, p, sizeof v);
+			return v;
+		}
+
+
+		static unsigned hash(std::uint32_t v) noexcept
+		{
+			return (v * 2654435761u) >> (32 - hash_bits);
+		}
+
+
+		static unsigned char* put_length(unsigned char* op, size_type len) noexcept
+		{
+			while (len >= 255)
+			{
+				*op++ = 255;
+				len -= 255;
+			}
+
+			*op++ = static_cast<unsigned char>(len);
+			return op;
+		}
+
+
+		static bool get_length(
+			const unsigned char*& ip,
+			const unsigned char* iend,
+			size_type& len) noexcept
+		{
+			unsigned char b;
+
+			do
+			{
+				if (ip == iend)
+				{
+					return false;
+				}
+
+				b = *ip++;
+				len += b;
+			}
+			while (b == 255);
+
+			return true;
+		}
+
+
+		static unsigned char* put_literals(
+			unsigned char* op,
+			unsigned char* token,
+			const unsigned char* lit,
+			size_type n) noexcept
+		{
+			if (n >= 15)
+			{
+				*token |= 15 << 4;
+				op = put_length(op, n - 15);
+			}
+			else
+			{
+				*token |= static_cast<unsigned char>(n << 4);
+			}
+
+			std::memcpy(op, lit, n);
+			return op + n;
+		}
+
+
+		static unsigned char* put_sequence(
+			unsigned char* op,
+			const unsigned char* lit,
+			size_type nlit,
+			size_type offset,
+			size_type len) noexcept
+		{
+			auto token = op++;
+			*token = 0;
+			op = put_literals(op, token, lit, nlit);
+			*op++ = static_cast<unsigned char>(offset);
+			*op++ = static_cast<unsigned char>(offset >> 8);
+			len -= min_match;
+
+			if (len >= 15)
+			{
+				*token |= 15;
+				op = put_length(op, len - 15);
+			}
+			else
+			{
+				*token |= static_cast<unsigned char>(len);
+			}
+
+			return op;
+		}
+
+	};
+
+}
+
+
+#endif
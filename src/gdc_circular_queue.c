@@ -27,6 +27,9 @@
 #include <unistd.h>
 #include <stdatomic.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+#include <stddef.h>
 #include <assert.h>
 #include <fcntl.h>
 
@@ -35,11 +38,33 @@
 #define LEVEL1_DCACHE_LINESIZE 64
 #endif
 
+// Padding between rpos, wpos and properties. 64 or 128 for one or two
+// cache lines, or 4096 to put them on separate pages. Recorded in every
+// queue and checked when mapping, since all users must agree on it.
+#ifndef GDC_CONTROL_BLOCK_PADDING
+#define GDC_CONTROL_BLOCK_PADDING LEVEL1_DCACHE_LINESIZE
+#endif
+
+#define GDC_CONTROL_BLOCK_MAGIC 0x51434447u
+
+
+struct gdc_circular_queue_layout
+{
+	// Overlaps rpos.
+	size_t reserved;
+	uint32_t magic;
+	uint32_t padding;
+};
+
 
 struct gdc_circular_queue_properties
 {
 	atomic_size_t capacity;
 	int sync;
+	// Bytes reserved for metadata, and offset of the data buffer from the
+	// beginning of the control block. Both are immutable.
+	size_t metadata_size;
+	size_t data_offset;
 };
 
 
@@ -51,7 +76,9 @@ typedef struct gdc_circular_queue
 		// Index of the next byte to read in the data buffer.
 		// Producer reads, consumer writes.
 		atomic_size_t rpos;
-		char pad_rpos[LEVEL1_DCACHE_LINESIZE];
+		// Layout record. Immutable, at the same offset in every layout.
+		struct gdc_circular_queue_layout layout;
+		char pad_rpos[GDC_CONTROL_BLOCK_PADDING];
 		char beginning;
 	};
 	
@@ -60,14 +87,14 @@ typedef struct gdc_circular_queue
 		// Index of the next byte to write in the data buffer.
 		// Producer writes, consumer reads.
 		atomic_size_t wpos;
-		char pad_wpos[LEVEL1_DCACHE_LINESIZE];
+		char pad_wpos[GDC_CONTROL_BLOCK_PADDING];
 	};
 	
 	union
 	{
 		// Capacity as number of bytes. This is immutable.
 		struct gdc_circular_queue_properties properties;
-		char pad_capacity[LEVEL1_DCACHE_LINESIZE];
+		char pad_capacity[GDC_CONTROL_BLOCK_PADDING];
 	};
 	
 	// Optional metadata.
@@ -90,14 +117,74 @@ static inline void advance_wpos(gdc_circular_queue *q, size_t len);
 static inline void advance_rpos(gdc_circular_queue *q, size_t len);
 
 
+size_t
+gdc_circular_queue_metadata_offset(void)
+{
+	return offsetof(gdc_circular_queue, metadata);
+}
+
+
+// Returns -1 if q was not created with this build's layout. errno is
+// EAGAIN if the layout record is not written yet, EPROTO otherwise.
 int
-gdc_circular_queue_init(
+gdc_circular_queue_check_layout(gdc_circular_queue *q)
+{
+	if (q->layout.magic == 0)
+	{
+		errno = EAGAIN;
+		return -1;
+	}
+	
+	if (q->layout.magic != GDC_CONTROL_BLOCK_MAGIC ||
+		q->layout.padding != GDC_CONTROL_BLOCK_PADDING)
+	{
+		errno = EPROTO;
+		return -1;
+	}
+	
+	return 0;
+}
+
+
+// Returns (size_t)-1 and sets errno if the page size is unknown.
+size_t
+gdc_circular_queue_data_offset(size_t metadata_size)
+{
+	long page_size = sysconf(_SC_PAGESIZE);
+	if (page_size == -1)
+	{
+		return (size_t)-1;
+	}
+	
+	// The control block and metadata take whole pages, at least one.
+	size_t n = gdc_circular_queue_metadata_offset() + metadata_size;
+	return (((n - 1) / page_size) + 1) * page_size;
+}
+
+
+int
+gdc_circular_queue_init_with_metadata(
 	gdc_circular_queue *q,
 	size_t capacity,
+	size_t metadata_size,
 	int sync,
 	int (*mdinit)(gdc_circular_queue*, void*),
 	void* md_context)
 {
+	size_t data_offset = gdc_circular_queue_data_offset(metadata_size);
+	if (data_offset == (size_t)-1)
+	{
+		return -1;
+	}
+	
+	q->layout.magic = GDC_CONTROL_BLOCK_MAGIC;
+	q->layout.padding = GDC_CONTROL_BLOCK_PADDING;
+	
+	// Metadata must be sized before mdinit so that it can check it.
+	q->properties.data_offset = data_offset;
+	q->properties.metadata_size =
+		q->properties.data_offset - gdc_circular_queue_metadata_offset();
+	
 	if (mdinit != NULL && mdinit(q, md_context) != 0)
 	{
 		return -1;
@@ -110,6 +197,19 @@ gdc_circular_queue_init(
 }
 
 
+int
+gdc_circular_queue_init(
+	gdc_circular_queue *q,
+	size_t capacity,
+	int sync,
+	int (*mdinit)(gdc_circular_queue*, void*),
+	void* md_context)
+{
+	return gdc_circular_queue_init_with_metadata(
+		q, capacity, 1, sync, mdinit, md_context);
+}
+
+
 void*
 gdc_circular_queue_metadata(gdc_circular_queue *q)
 {
@@ -117,17 +217,17 @@ gdc_circular_queue_metadata(gdc_circular_queue *q)
 }
 
 
+size_t
+gdc_circular_queue_metadata_size(gdc_circular_queue *q)
+{
+	return q->properties.metadata_size;
+}
+
+
 void*
 gdc_circular_queue_data(gdc_circular_queue *q)
 {
-	static long page_size = -1;
-	
-	if (page_size == -1)
-	{
-		page_size = sysconf(_SC_PAGESIZE);
-	}
-	
-	char *p = (char*)q + page_size;
+	char *p = (char*)q + q->properties.data_offset;
 	return p;
 }
 
@@ -292,7 +392,7 @@ space(gdc_circular_queue *q, size_t rp, size_t wp)
 		// xxxxx_____xxxxx
 		//      ^    ^
 		//     wp    rp
-		n = rp - wp;
+		n = rp - wp - 1;
 	}
 	
 	assert(n < capacity);
@@ -39,6 +39,10 @@
 #define LEVEL1_DCACHE_LINESIZE 64
 #endif
 
+#ifndef GDC_CONTROL_BLOCK_PADDING
+#define GDC_CONTROL_BLOCK_PADDING LEVEL1_DCACHE_LINESIZE
+#endif
+
 
 #ifdef __cplusplus
 extern "C" {
@@ -54,7 +58,19 @@ int gdc_circular_queue_init(
 	int sync,
 	int (*mdinit)(gdc_circular_queue*, void*),
 	void* md_context);
+int gdc_circular_queue_init_with_metadata(
+	gdc_circular_queue *q,
+	size_t capacity,
+	size_t metadata_size,
+	int sync,
+	int (*mdinit)(gdc_circular_queue*, void*),
+	void* md_context);
 void* gdc_circular_queue_metadata(gdc_circular_queue *q);
+size_t gdc_circular_queue_metadata_size(gdc_circular_queue *q);
+size_t gdc_circular_queue_metadata_offset(void);
+size_t gdc_circular_queue_data_offset(size_t metadata_size);
+int gdc_circular_queue_check_layout(gdc_circular_queue *q);
+void* gdc_circular_queue_data(gdc_circular_queue *q);
 size_t gdc_circular_queue_capacity(gdc_circular_queue *q);
 int gdc_circular_queue_empty(gdc_circular_queue *q);
 size_t gdc_circular_queue_available(gdc_circular_queue *q);
@@ -74,7 +90,10 @@ void gdc_circular_queue_commit(gdc_circular_queue *q, size_t len);
 #include <memory>
 #include <string>
 #include <atomic>
+#include <utility>
+#include <new>
 #include <cstddef>
+#include <cstring>
 #include <cassert>
 
 
@@ -125,6 +144,23 @@ namespace gdc
 		}
 		
 		
+		size_type metadata_size() const noexcept
+		{
+			auto q = reinterpret_cast<const gdc_circular_queue*>(this);
+			auto qq = const_cast<gdc_circular_queue*>(q);
+			return ::gdc_circular_queue_metadata_size(qq);
+		}
+		
+		
+		const char* data() const noexcept
+		{
+			auto q = reinterpret_cast<const gdc_circular_queue*>(this);
+			auto qq = const_cast<gdc_circular_queue*>(q);
+			auto p = ::gdc_circular_queue_data(qq);
+			return reinterpret_cast<const char*>(p);
+		}
+		
+		
 		bool empty() const noexcept
 		{
 			auto q = reinterpret_cast<const gdc_circular_queue*>(this);
@@ -203,6 +239,23 @@ namespace gdc
 		}
 		
 		
+		// Constructs T in place in the queue and commits it.
+		template<typename... Args>
+		bool emplace(Args&&... args)
+		{
+			auto p = alloc(sizeof (T));
+			
+			if (p == nullptr)
+			{
+				return false;
+			}
+			
+			new (p) T(std::forward<Args>(args)...);
+			commit(sizeof (T));
+			return true;
+		}
+		
+		
 		const_reference front() const
 		{
 			auto q = reinterpret_cast<const gdc_circular_queue*>(this);
@@ -30,23 +30,53 @@
 #include <memory>
 #include <string>
 #include <atomic>
+#include <utility>
+#include <new>
+#include <cstdint>
 #include <cstddef>
+#include <cstring>
 #include <cassert>
+#include <cerrno>
 #include <unistd.h>
 
+#include "gdc_circular_queue_error.hpp"
+
 
 #ifndef LEVEL1_DCACHE_LINESIZE
 #define LEVEL1_DCACHE_LINESIZE 64
 #endif
 
+// Padding between rpos, wpos and properties. 64 or 128 for one or two
+// cache lines, or 4096 to put them on separate pages. Recorded in every
+// queue and checked when mapping, since all users must agree on it.
+#ifndef GDC_CONTROL_BLOCK_PADDING
+#define GDC_CONTROL_BLOCK_PADDING LEVEL1_DCACHE_LINESIZE
+#endif
+
 
 namespace gdc
 {
 
+	const std::uint32_t circular_queue_layout_magic = 0x51434447;
+
+
+	struct circular_queue_layout
+	{
+		// Overlaps rpos.
+		size_t reserved;
+		std::uint32_t magic;
+		std::uint32_t padding;
+	};
+
+
 	struct circular_queue_properties
 	{
 		std::atomic<size_t> capacity;
 		int sync;
+		// Bytes reserved for metadata, and offset of the data buffer from
+		// the beginning of the control block. Both are immutable.
+		size_t metadata_size;
+		size_t data_offset;
 	};
 
 
@@ -58,7 +88,9 @@ namespace gdc
 			// Index of the next byte to read in the data buffer.
 			// Producer reads, consumer writes.
 			std::atomic<size_t> rpos;
-			char pad_rpos[LEVEL1_DCACHE_LINESIZE];
+			// Layout record. Immutable, at the same offset in every layout.
+			circular_queue_layout layout;
+			char pad_rpos[GDC_CONTROL_BLOCK_PADDING];
 			char beginning;
 		};
 		
@@ -67,14 +99,14 @@ namespace gdc
 			// Index of the next byte to write in the data buffer.
 			// Producer writes, consumer reads.
 			std::atomic<size_t> wpos;
-			char pad_wpos[LEVEL1_DCACHE_LINESIZE];
+			char pad_wpos[GDC_CONTROL_BLOCK_PADDING];
 		};
 		
 		union
 		{
 			// Capacity as number of bytes. This is immutable.
 			circular_queue_properties properties;
-			char pad_capacity[LEVEL1_DCACHE_LINESIZE];
+			char pad_capacity[GDC_CONTROL_BLOCK_PADDING];
 		};
 		
 		// Optional metadata.
@@ -82,6 +114,32 @@ namespace gdc
 		
 	};
 
+
+	// Whether a control block was created with this build's layout. A
+	// queue whose layout record is not written yet does not match.
+	inline bool circular_queue_layout_matches(const circular_queue_control_block& q) noexcept
+	{
+		return q.layout.magic == circular_queue_layout_magic &&
+			q.layout.padding == GDC_CONTROL_BLOCK_PADDING;
+	}
+
+
+	// Offset of the data buffer for a queue with the given metadata size.
+	// The control block and metadata take whole pages, at least one.
+	inline std::size_t circular_queue_data_offset(std::size_t metadata_size)
+	{
+		static long page_size = ::sysconf(_SC_PAGESIZE);
+		if (page_size == -1)
+		{
+			std::string what("sysconf: ");
+			what.append(::strerror(errno));
+			throw circular_queue_error(what);
+		}
+
+		std::size_t n = offsetof(circular_queue_control_block, metadata) + metadata_size;
+		return (((n - 1) / page_size) + 1) * page_size;
+	}
+
 	
 	template<typename T>
 	class circular_queue
@@ -129,11 +187,19 @@ namespace gdc
 		}
 
 
+		size_type metadata_size() const noexcept
+		{
+			return _q.properties.metadata_size;
+		}
+
+
 		const char* data() const noexcept
 		{
-			static long page_size = ::sysconf(_SC_PAGESIZE);
-			auto p = &_q.beginning + page_size;
-			return p;
+			// Data follows the control block and metadata pages. Go through an
+			// integer so that the compiler doesn't bound the result to the
+			// control block.
+			auto p = reinterpret_cast<std::uintptr_t>(&_q.beginning);
+			return reinterpret_cast<const char*>(p + _q.properties.data_offset);
 		}
 		
 		
@@ -201,7 +267,7 @@ namespace gdc
 				// xxxxx_____xxxxx
 				//      ^    ^
 				//     wp    rp
-				n = rp - wp;
+				n = rp - wp - 1;
 			}
 			
 			assert(n < c);
@@ -291,6 +357,24 @@ namespace gdc
 		}
 		
 		
+		// Constructs T in place in the queue and commits it.
+		template<typename... Args>
+		bool emplace(Args&&... args)
+			noexcept(std::is_nothrow_constructible<T, Args...>::value)
+		{
+			auto p = alloc(sizeof (T));
+			
+			if (p == nullptr)
+			{
+				return false;
+			}
+			
+			new (p) T(std::forward<Args>(args)...);
+			commit(sizeof (T));
+			return true;
+		}
+		
+		
 		const_reference front() const noexcept
 		{
 			auto p = peek();
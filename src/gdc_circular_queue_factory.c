@@ -37,29 +37,36 @@
 #include "gdc_circular_queue.h"
 
 
+// Returns (size_t)-1 and sets errno if data_offset is (size_t)-1 or the
+// page size is unknown.
 static size_t
-gdc_circular_queue_footprint(size_t capacity)
+gdc_circular_queue_footprint(size_t data_offset, size_t capacity)
 {
+	if (data_offset == (size_t)-1)
+	{
+		return (size_t)-1;
+	}
+	
 	long page_size = sysconf(_SC_PAGESIZE);
 	if (page_size == -1)
 	{
-		return 0;
+		return (size_t)-1;
 	}
 	assert(page_size > 0);
 	
 	if (capacity == 0)
 	{
-		return page_size;
+		return data_offset;
 	}
 	
-	// Calculate the smallest multiple of page size that is >= page size + capacity.
-	// The first page is for struct gdc_circular_queue. The other pages are for data.
-	// Examples:
+	// Calculate the smallest multiple of page size that is >= data offset + capacity.
+	// The first pages are for struct gdc_circular_queue and metadata. The other pages are for data.
+	// Examples with a single control page:
 	// capacity == 0 => footprint = page_size.
-	// capacity == 1 => footprint = page_size.
-	// capacity == page_size => footprint = page_size.
-	// capacity == page_size + 1 => footprint = 2 * page_size.
-	long footprint = page_size + (((capacity - 1) / page_size) + 1) * page_size;
+	// capacity == 1 => footprint = 2 * page_size.
+	// capacity == page_size => footprint = 2 * page_size.
+	// capacity == page_size + 1 => footprint = 3 * page_size.
+	long footprint = data_offset + (((capacity - 1) / page_size) + 1) * page_size;
 	return footprint;
 }
 
@@ -73,6 +80,20 @@ gdc_circular_queue_create_shared(
 	int sync,
 	int (*mdinit)(gdc_circular_queue*, void*),
 	void* md_context)
+{
+	return gdc_circular_queue_create_shared_with_metadata(
+		name, capacity, 0, sync, mdinit, md_context);
+}
+
+
+int
+gdc_circular_queue_create_shared_with_metadata(
+	const char* name,
+	size_t capacity,
+	size_t metadata_size,
+	int sync,
+	int (*mdinit)(gdc_circular_queue*, void*),
+	void* md_context)
 {
 	// Unlink any old shared memory object with the same name.
 	int status = shm_unlink(name);
@@ -89,7 +110,16 @@ gdc_circular_queue_create_shared(
 		return -1;
 	}
 	
-	size_t len = gdc_circular_queue_footprint(capacity) + capacity;
+	size_t data_offset = gdc_circular_queue_data_offset(metadata_size);
+	size_t footprint = gdc_circular_queue_footprint(data_offset, capacity);
+	if (footprint == (size_t)-1)
+	{
+		close(fd);
+		shm_unlink(name);
+		return -1;
+	}
+	
+	size_t len = footprint + capacity;
 	status = ftruncate(fd, len);
 	if (status != 0)
 	{
@@ -113,7 +143,8 @@ gdc_circular_queue_create_shared(
 	}
 	
 	gdc_circular_queue* q = p;
-	status = gdc_circular_queue_init(q, capacity, sync, mdinit, md_context);
+	status = gdc_circular_queue_init_with_metadata(
+		q, capacity, metadata_size, sync, mdinit, md_context);
 	
 	if (status == -1)
 	{
@@ -152,6 +183,19 @@ gdc_circular_queue_create_private(
 	int sync,
 	int (*mdinit)(gdc_circular_queue*, void*),
 	void* md_context)
+{
+	return gdc_circular_queue_create_private_with_metadata(
+		capacity, 0, sync, mdinit, md_context);
+}
+
+
+gdc_circular_queue*
+gdc_circular_queue_create_private_with_metadata(
+	size_t capacity,
+	size_t metadata_size,
+	int sync,
+	int (*mdinit)(gdc_circular_queue*, void*),
+	void* md_context)
 {
 	static atomic_int seq;
 	int unique = atomic_fetch_add_explicit(&seq, 1, memory_order_relaxed);
@@ -159,7 +203,8 @@ gdc_circular_queue_create_private(
 	char tmp_name[32];
 	sprintf(tmp_name, "/.gdc.%d.%d", pid, unique);
 	
-	if (gdc_circular_queue_create_shared(tmp_name, capacity, sync, mdinit, md_context) == -1)
+	if (gdc_circular_queue_create_shared_with_metadata(
+		tmp_name, capacity, metadata_size, sync, mdinit, md_context) == -1)
 	{
 		return NULL;
 	}
@@ -197,15 +242,62 @@ gdc_circular_queue_map_shared(const char *name)
 	
 	struct stat st;
 	int status = fstat(fd, &st);
-	if (status != 0 || st.st_size <= page_size)
+	if (status != 0 || st.st_size < page_size)
 	{
 		// Not fully initialized yet.
 		close(fd);
 		return NULL;
 	}
 	
-	size_t init_size = gdc_circular_queue_footprint(0);
+	// The layout record is at the same offset whatever the padding, so
+	// check it in the first page before sizing the control block with
+	// our padding. A small queue of a build with less padding may be
+	// shorter than our control block.
 	void *p = mmap(
+		NULL,
+		page_size,
+		PROT_READ,
+		MAP_SHARED,
+		fd,
+		0);
+	if (p == MAP_FAILED)
+	{
+		close(fd);
+		return NULL;
+	}
+	
+	atomic_thread_fence(memory_order_acquire);
+	
+	if (gdc_circular_queue_check_layout(p) != 0)
+	{
+		// Created with a different control block padding, or the layout
+		// record is not written yet. Segments of builds that predate the
+		// layout record never get one and must be recreated.
+		int e = errno;
+		munmap(p, page_size);
+		close(fd);
+		errno = e;
+		return NULL;
+	}
+	
+	munmap(p, page_size);
+	
+	// Map the control block.
+	size_t init_size = gdc_circular_queue_data_offset(0);
+	if (init_size == (size_t)-1)
+	{
+		close(fd);
+		return NULL;
+	}
+	
+	if ((size_t)st.st_size <= init_size)
+	{
+		// Not fully initialized yet.
+		close(fd);
+		return NULL;
+	}
+	
+	p = mmap(
 		NULL,
 		init_size,
 		PROT_READ | PROT_WRITE,
@@ -220,6 +312,7 @@ gdc_circular_queue_map_shared(const char *name)
 	
 	gdc_circular_queue *q = p;
 	atomic_thread_fence(memory_order_acquire);
+	
 	size_t capacity = gdc_circular_queue_capacity(q);
 	
 	if (capacity == 0)
@@ -230,7 +323,16 @@ gdc_circular_queue_map_shared(const char *name)
 		return NULL;
 	}
 	
-	size_t footprint = gdc_circular_queue_footprint(capacity);
+	size_t data_offset = gdc_circular_queue_data_offset(gdc_circular_queue_metadata_size(q));
+	size_t footprint = gdc_circular_queue_footprint(data_offset, capacity);
+	if (footprint == (size_t)-1)
+	{
+		int e = errno;
+		munmap(p, init_size);
+		close(fd);
+		errno = e;
+		return NULL;
+	}
 	
 	if (munmap(p, init_size) != 0)
 	{
@@ -259,7 +361,7 @@ gdc_circular_queue_map_shared(const char *name)
 		PROT_READ | PROT_WRITE, 
 		MAP_SHARED | MAP_FIXED,
 		fd,
-		page_size);
+		data_offset);
 	if (p2 == MAP_FAILED)
 	{
 		munmap(p, footprint + capacity);
@@ -284,7 +386,14 @@ gdc_circular_queue_unmap_shared(gdc_circular_queue *q)
 	if (q != NULL)
 	{
 		size_t capacity = gdc_circular_queue_capacity(q);
-		size_t footprint = gdc_circular_queue_footprint(capacity);
+		size_t metadata_size = gdc_circular_queue_metadata_size(q);
+		size_t data_offset = gdc_circular_queue_data_offset(metadata_size);
+		size_t footprint = gdc_circular_queue_footprint(data_offset, capacity);
+		if (footprint == (size_t)-1)
+		{
+			return -1;
+		}
+		
 		return munmap(q, footprint + capacity);
 	}
 	
@@ -41,6 +41,13 @@ int gdc_circular_queue_create_shared(
 	int sync,
 	int (*mdinit)(gdc_circular_queue*, void*),
 	void* md_context);
+int gdc_circular_queue_create_shared_with_metadata(
+	const char* name,
+	size_t capacity,
+	size_t metadata_size,
+	int sync,
+	int (*mdinit)(gdc_circular_queue*, void*),
+	void* md_context);
 int gdc_circular_queue_delete_shared(const char* name);
 
 gdc_circular_queue* gdc_circular_queue_create_private(
@@ -48,6 +55,12 @@ gdc_circular_queue* gdc_circular_queue_create_private(
 	int sync,
 	int (*mdinit)(gdc_circular_queue*, void*),
 	void* md_context);
+gdc_circular_queue* gdc_circular_queue_create_private_with_metadata(
+	size_t capacity,
+	size_t metadata_size,
+	int sync,
+	int (*mdinit)(gdc_circular_queue*, void*),
+	void* md_context);
 int gdc_circular_queue_delete_private(gdc_circular_queue *q);
 
 gdc_circular_queue* gdc_circular_queue_map_shared(const char* name);
@@ -61,6 +74,7 @@ int gdc_circular_queue_unmap_shared(gdc_circular_queue *q);
 #include <type_traits>
 #include <stdexcept>
 #include <memory>
+#include <functional>
 #include <string>
 #include <atomic>
 #include <cstddef>
@@ -68,20 +82,15 @@ int gdc_circular_queue_unmap_shared(gdc_circular_queue *q);
 #include <cassert>
 #include <cstring>
 #include <sys/mman.h>
+#include <unistd.h>
 #include <fcntl.h>
 
+#include "gdc_circular_queue_error.hpp"
+
 
 namespace gdc
 {
 	
-	class circular_queue_error : public virtual std::runtime_error
-	{
-	public:
-		circular_queue_error(const std::string& what) : std::runtime_error(what) {}
-		circular_queue_error(const char* what) : std::runtime_error(what) {}
-	};
-	
-	
 	template<typename T, typename Q = circular_queue<T>>
 	class circular_queue_factory
 	{
@@ -98,6 +107,7 @@ namespace gdc
 		
 		std::string _name;
 		size_type _capacity;
+		size_type _metadata_size;
 		bool _sync;
 		mdinit_type _metadata_initializer;
 		unique_ptr _q;
@@ -129,11 +139,23 @@ namespace gdc
 			size_type capacity,
 			bool sync,
 			mdinit_type metadata_initializer)
+		{
+			create_shared(name, capacity, sync, 0, metadata_initializer);
+		}
+		
+		
+		static void create_shared(
+			const std::string& name,
+			size_type capacity,
+			bool sync,
+			size_type metadata_size,
+			mdinit_type metadata_initializer)
 		{
 			void* mdinit_context = &metadata_initializer;
-			int status = ::gdc_circular_queue_create_shared(
+			int status = ::gdc_circular_queue_create_shared_with_metadata(
 				name.c_str(),
 				capacity,
+				metadata_size,
 				sync,
 				default_metadata_init,
 				mdinit_context);
@@ -193,10 +215,21 @@ namespace gdc
 			size_type capacity,
 			bool sync,
 			mdinit_type metadata_initializer)
+		{
+			return create_private(capacity, sync, 0, metadata_initializer);
+		}
+		
+		
+		static Q* create_private(
+			size_type capacity,
+			bool sync,
+			size_type metadata_size,
+			mdinit_type metadata_initializer)
 		{
 			void* mdinit_context = &metadata_initializer;
-			gdc_circular_queue* q = ::gdc_circular_queue_create_private(
+			gdc_circular_queue* q = ::gdc_circular_queue_create_private_with_metadata(
 				capacity,
+				metadata_size,
 				sync,
 				default_metadata_init,
 				mdinit_context);
@@ -245,7 +278,12 @@ namespace gdc
 				if (_capacity > 0)
 				{
 					// We set the capacity, hence we create the queue.
-					create_shared(_name, _capacity, _sync, _metadata_initializer);
+					create_shared(
+						_name,
+						_capacity,
+						_sync,
+						_metadata_size,
+						_metadata_initializer);
 				}
 				
 				_q = unique_ptr(map_shared(_name), unmap_shared);
@@ -256,6 +294,7 @@ namespace gdc
 					create_private(
 						_capacity,
 						_sync,
+						_metadata_size,
 						_metadata_initializer),
 					delete_private);
 			}
@@ -270,8 +309,22 @@ namespace gdc
 			size_type capacity,
 			bool sync = true,
 			mdinit_type metadata_initializer = [](Q&) -> int { return 0; }) :
+			circular_queue_factory(name, capacity, sync, 0, metadata_initializer)
+		{
+		}
+		
+		
+		// For creating a new shared memory queue with at least
+		// metadata_size bytes of metadata.
+		circular_queue_factory(
+			const std::string& name,
+			size_type capacity,
+			bool sync,
+			size_type metadata_size,
+			mdinit_type metadata_initializer = [](Q&) -> int { return 0; }) :
 			_name(name),
 			_capacity(capacity),
+			_metadata_size(metadata_size),
 			_sync(sync),
 			_metadata_initializer(metadata_initializer),
 			_q(nullptr, null_queue_destroyer)
@@ -285,6 +338,7 @@ namespace gdc
 		circular_queue_factory(const std::string& name) :
 			_name(name),
 			_capacity(0),
+			_metadata_size(0),
 			_sync(false),
 			_q(nullptr, null_queue_destroyer)
 		{
@@ -297,7 +351,20 @@ namespace gdc
 			size_type capacity,
 			bool sync = true,
 			mdinit_type metadata_initializer = [](Q&) -> int { return 0; }) :
+			circular_queue_factory(capacity, sync, 0, metadata_initializer)
+		{
+		}
+		
+		
+		// For creating a new in-process queue with at least metadata_size
+		// bytes of metadata.
+		circular_queue_factory(
+			size_type capacity,
+			bool sync,
+			size_type metadata_size,
+			mdinit_type metadata_initializer = [](Q&) -> int { return 0; }) :
 			_capacity(capacity),
+			_metadata_size(metadata_size),
 			_sync(sync),
 			_metadata_initializer(metadata_initializer),
 			_q(nullptr, null_queue_destroyer)
@@ -309,6 +376,7 @@ namespace gdc
 		circular_queue_factory(circular_queue_factory&& f) :
 			_name(std::move(f._name)),
 			_capacity(f._capacity),
+			_metadata_size(f._metadata_size),
 			_sync(f._sync),
 			_metadata_initializer(std::move(f._metadata_initializer)),
 			_q(std::move(f._q))
@@ -361,6 +429,13 @@ namespace gdc
 		{
 			return _q.get() != nullptr;
 		}
+
+
+		// Empty for in-process queues.
+		const std::string& name() const
+		{
+			return _name;
+		}
 		
 	};
 	
@@ -32,6 +32,7 @@
 #include <type_traits>
 #include <stdexcept>
 #include <memory>
+#include <functional>
 #include <string>
 #include <atomic>
 #include <cstddef>
@@ -40,19 +41,12 @@
 #include <cstring>
 
 #include "gdc_circular_queue.hpp"
+#include "gdc_circular_queue_error.hpp"
 
 
 namespace gdc
 {
 	
-	class circular_queue_error : public virtual std::runtime_error
-	{
-	public:
-		circular_queue_error(const std::string& what) : std::runtime_error(what) {}
-		circular_queue_error(const char* what) : std::runtime_error(what) {}
-	};
-	
-	
 	template<typename T, typename Q = circular_queue<T>>
 	class circular_queue_factory
 	{
@@ -69,6 +63,7 @@ namespace gdc
 		
 		std::string _name;
 		size_type _capacity;
+		size_type _metadata_size;
 		bool _sync;
 		mdinit_type _metadata_initializer;
 		unique_ptr _q;
@@ -80,31 +75,33 @@ namespace gdc
 		}
 		
 		
-		static size_type footprint(size_type capacity)
+		static size_type footprint(size_type data_offset, size_type capacity)
 		{
 			static long page_size = ::sysconf(_SC_PAGESIZE);
 			if (page_size == -1)
 			{
-				return 0;
+				std::string what("sysconf: ");
+				what.append(::strerror(errno));
+				throw circular_queue_error(what);
 			}
 			assert(page_size > 0);
 			
 			if (capacity == 0)
 			{
-				return page_size;
+				return data_offset;
 			}
 			
 			// Calculate the smallest multiple of page size such that
-			// size >= page size + capacity.
-			// The first page is for control data.
+			// size >= data offset + capacity.
+			// The first pages are for control data and metadata.
 			// The other pages are for data.
 			//
-			// Examples:
+			// Examples with a single control page:
 			// capacity == 0 => footprint = page_size.
-			// capacity == 1 => footprint = page_size.
-			// capacity == page_size => footprint = page_size.
-			// capacity == page_size + 1 => footprint = 2 * page_size.
-			long footprint = page_size + (((capacity - 1) / page_size) + 1) * page_size;
+			// capacity == 1 => footprint = 2 * page_size.
+			// capacity == page_size => footprint = 2 * page_size.
+			// capacity == page_size + 1 => footprint = 3 * page_size.
+			long footprint = data_offset + (((capacity - 1) / page_size) + 1) * page_size;
 			return footprint;
 		}
 
@@ -117,6 +114,20 @@ namespace gdc
 			bool sync,
 			mdinit_type metadata_initializer)
 		{
+			create_shared(name, capacity, sync, 0, metadata_initializer);
+		}
+		
+		
+		static void create_shared(
+			const std::string& name,
+			size_type capacity,
+			bool sync,
+			size_type metadata_size,
+			mdinit_type metadata_initializer)
+		{
+			size_type data_offset = circular_queue_data_offset(metadata_size);
+			size_t len = footprint(data_offset, capacity) + capacity;
+			
 			// Unlink any old shared memory object with the same name.
 			int status = ::shm_unlink(name.c_str());
 			if (status == -1 && errno != ENOENT)
@@ -136,7 +147,6 @@ namespace gdc
 				throw circular_queue_error(what);
 			}
 			
-			size_t len = footprint(capacity) + capacity;
 			status = ::ftruncate(fd, len);
 			if (status != 0)
 			{
@@ -165,9 +175,17 @@ namespace gdc
 			
 			try
 			{
+				// Metadata must be sized before the initializer can use it.
+				// Write it after constructing Q, or the compiler may treat the
+				// stores as dead.
 				auto q = new (p) Q();
-				metadata_initializer(*q);
 				auto qq = reinterpret_cast<circular_queue_control_block*>(p);
+				qq->layout.magic = circular_queue_layout_magic;
+				qq->layout.padding = GDC_CONTROL_BLOCK_PADDING;
+				qq->properties.data_offset = data_offset;
+				qq->properties.metadata_size =
+					data_offset - offsetof(circular_queue_control_block, metadata);
+				metadata_initializer(*q);
 				qq->properties.sync = sync;
 				qq->properties.capacity.store(capacity, std::memory_order_release);
 			}
@@ -220,7 +238,8 @@ namespace gdc
 				throw circular_queue_error(what);
 			}
 			
-			size_type init_size = footprint(0);
+			// Map the control block, whatever its padding.
+			size_type init_size = circular_queue_data_offset(0);
 			auto p = ::mmap(
 				NULL,
 				init_size,
@@ -237,7 +256,31 @@ namespace gdc
 			}
 			
 			Q* q = new (p) Q();
+			auto qq = reinterpret_cast<const circular_queue_control_block*>(p);
+
+			if (qq->layout.magic == 0)
+			{
+				// Layout record not written yet. Segments of builds that
+				// predate the layout record never get one.
+				::munmap(p, init_size);
+				::close(fd);
+				throw circular_queue_error("Not fully initialized yet.");
+			}
+
+			if (!circular_queue_layout_matches(*qq))
+			{
+				auto padding = qq->layout.padding;
+				::munmap(p, init_size);
+				::close(fd);
+				std::string what("Control block layout mismatch: queue padding ");
+				what.append(std::to_string(padding));
+				what.append(", expected ");
+				what.append(std::to_string(GDC_CONTROL_BLOCK_PADDING));
+				throw circular_queue_error(what);
+			}
+
 			size_type capacity = q->capacity();
+			size_type data_offset = circular_queue_data_offset(q->metadata_size());
 			
 			if (capacity == 0)
 			{
@@ -255,7 +298,7 @@ namespace gdc
 				throw circular_queue_error(what);
 			}
 			
-			size_type fp = footprint(capacity);
+			size_type fp = footprint(data_offset, capacity);
 			p = ::mmap(
 				NULL,
 				fp + capacity,
@@ -279,7 +322,7 @@ namespace gdc
 				PROT_READ | PROT_WRITE, 
 				MAP_SHARED | MAP_FIXED,
 				fd,
-				page_size);
+				data_offset);
 			if (p2 == MAP_FAILED)
 			{
 				std::string what("mmap: ");
@@ -310,7 +353,8 @@ namespace gdc
 			}
 
 			size_type capacity = q->capacity();
-			size_type fp = footprint(capacity);
+			size_type data_offset = circular_queue_data_offset(q->metadata_size());
+			size_type fp = footprint(data_offset, capacity);
 
 			if (::munmap(q, fp + capacity) == -1)
 			{
@@ -325,13 +369,23 @@ namespace gdc
 			size_type capacity,
 			bool sync,
 			mdinit_type metadata_initializer)
+		{
+			return create_private(capacity, sync, 0, metadata_initializer);
+		}
+		
+		
+		static Q* create_private(
+			size_type capacity,
+			bool sync,
+			size_type metadata_size,
+			mdinit_type metadata_initializer)
 		{
 			static std::atomic<int> seq(0);
 			int unique = seq.fetch_add(1, std::memory_order_relaxed);
 			pid_t pid = ::getpid();
 			char tmp_name[32];
 			std::sprintf(tmp_name, "/.gdcq.%d.%d", pid, unique);
-			create_shared(tmp_name, capacity, sync, metadata_initializer);
+			create_shared(tmp_name, capacity, sync, metadata_size, metadata_initializer);
 			Q* q = nullptr;
 
 			try
@@ -386,7 +440,12 @@ namespace gdc
 				if (_capacity > 0)
 				{
 					// We set the capacity, hence we create the queue.
-					create_shared(_name, _capacity, _sync, _metadata_initializer);
+					create_shared(
+						_name,
+						_capacity,
+						_sync,
+						_metadata_size,
+						_metadata_initializer);
 				}
 				
 				_q = unique_ptr(map_shared(_name), unmap_shared);
@@ -397,6 +456,7 @@ namespace gdc
 					create_private(
 						_capacity,
 						_sync,
+						_metadata_size,
 						_metadata_initializer),
 					delete_private);
 			}
@@ -413,8 +473,22 @@ namespace gdc
 			size_type capacity,
 			bool sync = true,
 			mdinit_type metadata_initializer = [](Q&) -> int { return 0; }) :
+			circular_queue_factory(name, capacity, sync, 0, metadata_initializer)
+		{
+		}
+		
+		
+		// For creating a new shared memory queue with at least
+		// metadata_size bytes of metadata.
+		circular_queue_factory(
+			const std::string& name,
+			size_type capacity,
+			bool sync,
+			size_type metadata_size,
+			mdinit_type metadata_initializer = [](Q&) -> int { return 0; }) :
 			_name(name),
 			_capacity(capacity),
+			_metadata_size(metadata_size),
 			_sync(sync),
 			_metadata_initializer(metadata_initializer),
 			_q(nullptr, null_queue_destroyer)
@@ -428,6 +502,7 @@ namespace gdc
 		circular_queue_factory(const std::string& name) :
 			_name(name),
 			_capacity(0),
+			_metadata_size(0),
 		    _sync(false),
 			_q(nullptr, null_queue_destroyer)
 		{
@@ -440,7 +515,20 @@ namespace gdc
 			size_type capacity,
 			bool sync = true,
 			mdinit_type metadata_initializer = [](Q&) -> int { return 0; }) :
+			circular_queue_factory(capacity, sync, 0, metadata_initializer)
+		{
+		}
+		
+		
+		// For creating a new in-process queue with at least metadata_size
+		// bytes of metadata.
+		circular_queue_factory(
+			size_type capacity,
+			bool sync,
+			size_type metadata_size,
+			mdinit_type metadata_initializer = [](Q&) -> int { return 0; }) :
 			_capacity(capacity),
+			_metadata_size(metadata_size),
 			_sync(sync),
 			_metadata_initializer(metadata_initializer),
 			_q(nullptr, null_queue_destroyer)
@@ -452,6 +540,7 @@ namespace gdc
 		circular_queue_factory(circular_queue_factory&& f) :
 			_name(std::move(f._name)),
 			_capacity(f._capacity),
+			_metadata_size(f._metadata_size),
 			_metadata_initializer(std::move(f._metadata_initializer)),
 			_q(std::move(f._q))
 		{
@@ -503,6 +592,13 @@ namespace gdc
 		{
 			return _q.get() != nullptr;
 		}
+
+
+		// Empty for in-process queues.
+		const std::string& name() const
+		{
+			return _name;
+		}
 		
 	};
 	
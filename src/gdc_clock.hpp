@@ -0,0 +1,83 @@
+//
+// Copyright (c) 2016 Dado Colussi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+#ifndef __gdc__clock__
+#define __gdc__clock__
+
+
+#include <chrono>
+#include <cstdint>
+
+
+namespace gdc
+{
+
+	// Monotonic time in nanoseconds. Comparable between processes on the
+	// same host.
+	inline std::uint64_t clock_ns() noexcept
+	{
+		auto t = std::chrono::steady_clock::now().time_since_epoch();
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(t).count();
+	}
+
+
+	// Cycle counter: the TSC on x86, clock_ns() elsewhere. Much cheaper
+	// than clock_ns() but only meaningful as a difference on one host, and
+	// only steady with an invariant TSC.
+	inline std::uint64_t tsc() noexcept
+	{
+#if defined(__x86_64__) || defined(__i386__)
+		return __builtin_ia32_rdtsc();
+#else
+		return clock_ns();
+#endif
+	}
+
+
+	// tsc() ticks per nanosecond, measured over 1 ms on first use.
+	inline double tsc_per_ns()
+	{
+		static const double ratio = []()
+		{
+			auto n0 = clock_ns();
+			auto t0 = tsc();
+			std::uint64_t n1;
+
+			do
+			{
+				n1 = clock_ns();
+			}
+			while (n1 - n0 < 1000000);
+
+			auto t1 = tsc();
+			return static_cast<double>(t1 - t0) / (n1 - n0);
+		}();
+
+		return ratio;
+	}
+
+}
+
+
+#endif
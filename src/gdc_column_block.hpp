@@ -0,0 +1,314 @@
+//
+// Copyright (c) 2016 Dado Colussi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+#ifndef __gdc__column_block__
+#define __gdc__column_block__
+
+
+#include <type_traits>
+#include <tuple>
+#include <cstdint>
+#include <cstddef>
+#include <cassert>
+
+#include "gdc_framed_queue.hpp"
+
+
+// Struct-of-arrays blocks of up to Rows records carried as single records
+// in a framed_queue<Q>. Every column starts at a column_alignment boundary
+// so that consumers can run vectorized loops straight on the queue memory.
+//
+// Payload layout:
+//
+// column_block_header | padding | column 0 | padding | column 1 | ...
+//
+// Columns are aligned relative to the address of the payload. Queue data
+// is page aligned and the mirror mapping preserves the offset within a
+// page, so producer and consumer agree on the padding.
+
+
+namespace gdc
+{
+
+	struct column_block_header
+	{
+		// Number of valid rows in the block.
+		std::uint32_t rows;
+		std::uint32_t reserved;
+	};
+
+
+	namespace detail
+	{
+		constexpr std::size_t align_up(std::size_t n, std::size_t a) noexcept
+		{
+			return (n + a - 1) / a * a;
+		}
+
+
+		// Offset of column I from the first column.
+		template<std::size_t Rows, std::size_t A, std::size_t I, typename... Ts>
+		struct column_offset;
+
+		template<std::size_t Rows, std::size_t A>
+		struct column_offset<Rows, A, 0>
+		{
+			static const std::size_t value = 0;
+		};
+
+		template<std::size_t Rows, std::size_t A, typename T, typename... Ts>
+		struct column_offset<Rows, A, 0, T, Ts...>
+		{
+			static const std::size_t value = 0;
+		};
+
+		template<std::size_t Rows, std::size_t A, std::size_t I, typename T, typename... Ts>
+		struct column_offset<Rows, A, I, T, Ts...>
+		{
+			static const std::size_t value =
+				align_up(Rows * sizeof (T), A) +
+				column_offset<Rows, A, I - 1, Ts...>::value;
+		};
+	}
+
+
+	template<std::size_t Rows, typename... Columns>
+	struct column_block
+	{
+		static_assert(Rows > 0, "column_block must have at least one row");
+
+		static const std::size_t rows = Rows;
+		static const std::size_t columns = sizeof...(Columns);
+		static const std::size_t column_alignment = 64;
+
+		template<std::size_t I>
+		using column_type = typename std::tuple_element<I, std::tuple<Columns...>>::type;
+
+		// Payload bytes reserved for one block, including worst case padding
+		// after the header.
+		static const std::size_t payload_size =
+			sizeof (column_block_header) +
+			column_alignment - sizeof (column_block_header) +
+			detail::column_offset<Rows, column_alignment, columns, Columns...>::value;
+
+
+		template<std::size_t I>
+		static constexpr std::size_t offset() noexcept
+		{
+			return detail::column_offset<Rows, column_alignment, I, Columns...>::value;
+		}
+
+
+		// Returns the address of the first column of the block at payload p.
+		static char* base(void* p) noexcept
+		{
+			auto a = reinterpret_cast<std::uintptr_t>(p) + sizeof (column_block_header);
+			auto b = detail::align_up(a, column_alignment);
+			return reinterpret_cast<char*>(b);
+		}
+
+
+		static const char* base(const void* p) noexcept
+		{
+			return base(const_cast<void*>(p));
+		}
+	};
+
+
+	template<std::size_t Rows, typename... Columns>
+	const std::size_t column_block<Rows, Columns...>::rows;
+
+	template<std::size_t Rows, typename... Columns>
+	const std::size_t column_block<Rows, Columns...>::columns;
+
+	template<std::size_t Rows, typename... Columns>
+	const std::size_t column_block<Rows, Columns...>::column_alignment;
+
+	template<std::size_t Rows, typename... Columns>
+	const std::size_t column_block<Rows, Columns...>::payload_size;
+
+
+	// Appends rows to blocks in a framed_queue<Q>. A block is published when
+	// it is full or on flush(). No other records can be written to the same
+	// framed queue while a block is open.
+	template<typename Q, typename Block>
+	class column_block_writer
+	{
+	public:
+
+		typedef typename Q::size_type size_type;
+
+
+		explicit column_block_writer(framed_queue<Q>& fq) noexcept :
+			_fq(fq),
+			_p(nullptr),
+			_rows(0)
+		{
+		}
+
+
+		column_block_writer(const column_block_writer&) = delete;
+		column_block_writer& operator=(const column_block_writer&) = delete;
+
+
+		size_type rows() const noexcept
+		{
+			return _rows;
+		}
+
+
+		// Opens a new block if none is open. Returns false if the queue is
+		// full.
+		bool open()
+		{
+			if (_p != nullptr)
+			{
+				return true;
+			}
+
+			_p = _fq.alloc(Block::payload_size);
+			_rows = 0;
+			return _p != nullptr;
+		}
+
+
+		// Column I of the open block, for filling rows in bulk. Call
+		// commit_rows() afterwards.
+		template<std::size_t I>
+		typename Block::template column_type<I>* column() const noexcept
+		{
+			assert(_p != nullptr);
+			auto b = Block::base(_p) + Block::template offset<I>();
+			return reinterpret_cast<typename Block::template column_type<I>*>(b);
+		}
+
+
+		// Marks n more rows of the open block as written.
+		void commit_rows(size_type n)
+		{
+			assert(_p != nullptr);
+			assert(_rows + n <= Block::rows);
+			_rows += n;
+
+			if (_rows == Block::rows)
+			{
+				flush();
+			}
+		}
+
+
+		template<typename... Args>
+		bool append(const Args&... values)
+		{
+			static_assert(
+				sizeof...(Args) == Block::columns,
+				"column_block_writer::append() needs one value per column");
+
+			if (!open())
+			{
+				return false;
+			}
+
+			set<0>(values...);
+			commit_rows(1);
+			return true;
+		}
+
+
+		// Publishes the open block. Returns false if no rows were written.
+		bool flush()
+		{
+			if (_p == nullptr || _rows == 0)
+			{
+				return false;
+			}
+
+			auto h = reinterpret_cast<column_block_header*>(_p);
+			h->rows = static_cast<std::uint32_t>(_rows);
+			h->reserved = 0;
+			_fq.commit(Block::payload_size, record_tag<Block>::value);
+			_p = nullptr;
+			_rows = 0;
+			return true;
+		}
+
+	private:
+
+		template<std::size_t I>
+		void set() noexcept
+		{
+		}
+
+
+		template<std::size_t I, typename T, typename... Ts>
+		void set(const T& value, const Ts&... values) noexcept
+		{
+			column<I>()[_rows] = value;
+			set<I + 1>(values...);
+		}
+
+
+		framed_queue<Q>& _fq;
+		void* _p;
+		size_type _rows;
+
+	};
+
+
+	// Read-only view of a column_block record.
+	template<typename Block>
+	class column_block_view
+	{
+	public:
+
+		explicit column_block_view(const record_header* h) noexcept :
+			_p(h + 1)
+		{
+			assert(h->size == Block::payload_size);
+		}
+
+
+		std::size_t rows() const noexcept
+		{
+			return reinterpret_cast<const column_block_header*>(_p)->rows;
+		}
+
+
+		template<std::size_t I>
+		const typename Block::template column_type<I>* column() const noexcept
+		{
+			auto b = Block::base(_p) + Block::template offset<I>();
+			return reinterpret_cast<const typename Block::template column_type<I>*>(b);
+		}
+
+	private:
+
+		const void* _p;
+
+	};
+
+}
+
+
+#endif
@@ -0,0 +1,322 @@
+//
+// Copyright (c) 2016 Dado Colussi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+
+#ifndef __gdc__consumer__
+#define __gdc__consumer__
+
+#include <pthread.h>
+#include <time.h>
+
+#include <functional>
+#include <memory>
+#include <vector>
+#include <string>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <cassert>
+
+#include "gdc_circular_queue_error.hpp"
+#include "gdc_clock.hpp"
+#include "gdc_thread.hpp"
+#include "gdc_wait_strategy.hpp"
+
+
+namespace gdc
+{
+
+	struct consumer_options
+	{
+		consumer_options() :
+			cpu(-1),
+			fifo_priority(0),
+			lock_memory(false),
+			wait(wait_mode::busy_poll),
+			time_handlers(true)
+		{
+		}
+
+		// CPU to pin the consumer thread to, or -1.
+		int cpu;
+
+		// SCHED_FIFO priority, or 0 to keep the default policy.
+		int fifo_priority;
+
+		// Whether to mlockall() the process before consuming.
+		bool lock_memory;
+
+		wait_mode wait;
+
+		// Whether to time each handler call. Costs two clock reads a call.
+		bool time_handlers;
+	};
+
+
+	// Runs queue handlers on a dedicated thread. Each iteration calls every
+	// handler once, in the order they were added; a handler returns the
+	// number of records it consumed, 0 meaning it found nothing to do.
+	class consumer_runtime
+	{
+	public:
+
+		typedef std::size_t size_type;
+		typedef std::function<size_type()> handler_type;
+
+
+		struct handler_stats
+		{
+			std::string name;
+			std::uint64_t calls;
+			std::uint64_t busy_calls;
+			std::uint64_t records;
+			std::uint64_t nanoseconds;
+		};
+
+
+		struct consumer_stats
+		{
+			std::uint64_t busy_iterations;
+			std::uint64_t idle_iterations;
+			std::uint64_t wall_nanoseconds;
+			std::uint64_t cpu_nanoseconds;
+			std::vector<handler_stats> handlers;
+		};
+
+
+		explicit consumer_runtime(const consumer_options& options = consumer_options()) :
+			_options(options),
+			_running(false),
+			_busy(0),
+			_idle(0),
+			_start_time(0),
+			_stop_time(0),
+			_cpu_time(0)
+		{
+		}
+
+
+		consumer_runtime(const consumer_runtime&) = delete;
+		consumer_runtime& operator=(const consumer_runtime&) = delete;
+
+
+		~consumer_runtime()
+		{
+			halt();
+		}
+
+
+		void add_handler(const std::string& name, handler_type handler)
+		{
+			assert(!_worker.joinable());
+			std::unique_ptr<handler_state> h(new handler_state());
+			h->name = name;
+			h->handler = handler;
+			_handlers.push_back(std::move(h));
+		}
+
+
+		void start()
+		{
+			assert(!_worker.joinable());
+			_running.store(true, std::memory_order_release);
+			_start_time = clock_ns();
+			_stop_time = 0;
+			_worker.start(_running, [this]() { run(); });
+		}
+
+
+		// Stops and joins the consumer thread. Rethrows an exception thrown
+		// by a handler or while setting up the thread.
+		void stop()
+		{
+			halt();
+			_worker.rethrow();
+		}
+
+
+		bool running() const noexcept
+		{
+			return _running.load(std::memory_order_relaxed);
+		}
+
+
+		consumer_stats statistics() const
+		{
+			consumer_stats st;
+			st.busy_iterations = _busy.load(std::memory_order_relaxed);
+			st.idle_iterations = _idle.load(std::memory_order_relaxed);
+			auto end = _stop_time != 0 ? _stop_time : clock_ns();
+			st.wall_nanoseconds = _start_time != 0 ? end - _start_time : 0;
+			st.cpu_nanoseconds = _cpu_time.load(std::memory_order_relaxed);
+
+			for (auto& h : _handlers)
+			{
+				handler_stats hs;
+				hs.name = h->name;
+				hs.calls = h->calls.load(std::memory_order_relaxed);
+				hs.busy_calls = h->busy_calls.load(std::memory_order_relaxed);
+				hs.records = h->records.load(std::memory_order_relaxed);
+				hs.nanoseconds = h->nanoseconds.load(std::memory_order_relaxed);
+				st.handlers.push_back(hs);
+			}
+
+			return st;
+		}
+
+	private:
+
+		struct handler_state
+		{
+			handler_state() :
+				calls(0),
+				busy_calls(0),
+				records(0),
+				nanoseconds(0)
+			{
+			}
+
+			std::string name;
+			handler_type handler;
+
+			// Written by the consumer thread only.
+			std::atomic<std::uint64_t> calls;
+			std::atomic<std::uint64_t> busy_calls;
+			std::atomic<std::uint64_t> records;
+			std::atomic<std::uint64_t> nanoseconds;
+		};
+
+
+		static std::uint64_t thread_cpu_ns() noexcept
+		{
+			timespec ts;
+			::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+			return static_cast<std::uint64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+		}
+
+
+		void setup()
+		{
+			if (_options.lock_memory)
+			{
+				lock_process_memory();
+			}
+
+			if (_options.cpu >= 0)
+			{
+				pin_current_thread(_options.cpu);
+			}
+
+			if (_options.fifo_priority > 0)
+			{
+				set_current_thread_fifo_priority(_options.fifo_priority);
+			}
+		}
+
+
+		size_type poll()
+		{
+			size_type total = 0;
+
+			for (auto& h : _handlers)
+			{
+				std::uint64_t t0 = _options.time_handlers ? clock_ns() : 0;
+				auto n = h->handler();
+
+				if (_options.time_handlers)
+				{
+					add_relaxed(h->nanoseconds, clock_ns() - t0);
+				}
+
+				add_relaxed(h->calls, 1);
+
+				if (n > 0)
+				{
+					add_relaxed(h->busy_calls, 1);
+					add_relaxed(h->records, n);
+					total += n;
+				}
+			}
+
+			return total;
+		}
+
+
+		void run()
+		{
+			std::uint64_t iterations = 0;
+
+			try
+			{
+				setup();
+
+				poll_while(_running, _options.wait, [&]()
+				{
+					if ((++iterations & 1023) == 0)
+					{
+						_cpu_time.store(thread_cpu_ns(), std::memory_order_relaxed);
+					}
+
+					auto n = poll();
+					add_relaxed(n > 0 ? _busy : _idle, 1);
+					return n;
+				});
+			}
+			catch (...)
+			{
+				_cpu_time.store(thread_cpu_ns(), std::memory_order_relaxed);
+				throw;
+			}
+
+			_cpu_time.store(thread_cpu_ns(), std::memory_order_relaxed);
+		}
+
+
+		void halt() noexcept
+		{
+			_running.store(false, std::memory_order_relaxed);
+
+			if (_worker.join())
+			{
+				_stop_time = clock_ns();
+			}
+		}
+
+
+		consumer_options _options;
+		std::vector<std::unique_ptr<handler_state>> _handlers;
+		worker_thread _worker;
+		std::atomic<bool> _running;
+		std::atomic<std::uint64_t> _busy;
+		std::atomic<std::uint64_t> _idle;
+		std::uint64_t _start_time;
+		std::uint64_t _stop_time;
+		std::atomic<std::uint64_t> _cpu_time;
+
+	};
+
+}
+
+
+#endif
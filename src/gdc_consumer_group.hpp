@@ -0,0 +1,316 @@
+//
+// Copyright (c) 2016 Dado Colussi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+
+#ifndef __gdc__consumer_group__
+#define __gdc__consumer_group__
+
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include <cassert>
+
+#include "gdc_circular_queue_error.hpp"
+#include "gdc_framed_queue.hpp"
+
+
+#ifndef LEVEL1_DCACHE_LINESIZE
+#define LEVEL1_DCACHE_LINESIZE 64
+#endif
+
+
+namespace gdc
+{
+
+	const std::size_t consumer_group_max_members = 16;
+
+
+	// Shared state of a consumer_group, kept in the queue metadata.
+	// Positions count bytes from queue creation and never wrap.
+	struct consumer_group_control
+	{
+		union
+		{
+			// Start of the first record not yet claimed.
+			std::atomic<std::uint64_t> claim;
+			char pad_claim[LEVEL1_DCACHE_LINESIZE];
+		};
+
+		union
+		{
+			// Where rpos stands: everything before is processed.
+			std::atomic<std::uint64_t> completed;
+			char pad_completed[LEVEL1_DCACHE_LINESIZE];
+		};
+
+		union
+		{
+			// Held by the member advancing rpos.
+			std::atomic<std::uint32_t> advancing;
+			char pad_advancing[LEVEL1_DCACHE_LINESIZE];
+		};
+
+		// Start of the batch each member is claiming or processing, or
+		// consumer_group_idle.
+		union member
+		{
+			std::atomic<std::uint64_t> start;
+			char pad[LEVEL1_DCACHE_LINESIZE];
+		} members[consumer_group_max_members];
+	};
+
+
+	const std::uint64_t consumer_group_idle = ~std::uint64_t(0);
+
+
+	// Records claimed by one member. Records are contiguous thanks to the
+	// second view of the data.
+	struct claimed_batch
+	{
+		const record_header* first;
+		std::size_t records;
+		std::size_t bytes;
+		std::uint64_t start;
+
+
+		explicit operator bool() const noexcept
+		{
+			return records > 0;
+		}
+
+
+		// The record after h in the batch, or nullptr after the last one.
+		const record_header* next(const record_header* h) const noexcept
+		{
+			auto p = reinterpret_cast<const char*>(h) + record_footprint(h->size);
+			auto end = reinterpret_cast<const char*>(first) + bytes;
+			return p < end ? reinterpret_cast<const record_header*>(p) : nullptr;
+		}
+	};
+
+
+	// Competing consumers of a framed_queue<Q> stream: each record goes to
+	// exactly one member. Members claim batches of records by CAS on a
+	// shared claim cursor and may finish them in any order; rpos advances
+	// over the batches once every earlier batch is complete, so a slow
+	// member holds back space but never other members.
+	//
+	// Create the queue with footprint() bytes of metadata and init as the
+	// metadata initializer. Each member, in any thread or process,
+	// attaches with its own id below consumer_group_max_members. A member
+	// that dies holding a batch stops rpos for good.
+	template<typename Q>
+	class consumer_group
+	{
+	public:
+
+		typedef std::size_t size_type;
+
+
+		static constexpr size_type footprint() noexcept
+		{
+			return sizeof (consumer_group_control);
+		}
+
+
+		// Metadata initializer for the queue.
+		static int init(Q& q)
+		{
+			if (q.metadata_size() < footprint())
+			{
+				return -1;
+			}
+
+			auto c = reinterpret_cast<consumer_group_control*>(q.metadata());
+			c->claim.store(0, std::memory_order_relaxed);
+			c->completed.store(0, std::memory_order_relaxed);
+			c->advancing.store(0, std::memory_order_relaxed);
+
+			for (auto& m : c->members)
+			{
+				m.start.store(consumer_group_idle, std::memory_order_relaxed);
+			}
+
+			std::atomic_thread_fence(std::memory_order_release);
+			return 0;
+		}
+
+
+		consumer_group(Q& q, size_type id) :
+			_q(q),
+			_c(reinterpret_cast<consumer_group_control*>(q.metadata())),
+			_start(nullptr)
+		{
+			if (q.metadata_size() < footprint())
+			{
+				throw circular_queue_error("Queue metadata too small for consumer_group.");
+			}
+
+			if (id >= consumer_group_max_members)
+			{
+				throw circular_queue_error("consumer_group member id " + std::to_string(id) + " out of range");
+			}
+
+			_start = &_c->members[id].start;
+		}
+
+
+		consumer_group(const consumer_group&) = delete;
+		consumer_group& operator=(const consumer_group&) = delete;
+
+
+		// Claims up to max_records records. The batch is empty if there
+		// is nothing to claim. Complete a batch before claiming the next.
+		claimed_batch claim(size_type max_records)
+		{
+			assert(max_records > 0);
+			assert(_start->load(std::memory_order_relaxed) == consumer_group_idle);
+			auto capacity = _q.capacity();
+
+			for (;;)
+			{
+				auto c = _c->claim.load(std::memory_order_acquire);
+
+				// Announce the batch before taking it, so that rpos cannot
+				// pass it in between.
+				_start->store(c, std::memory_order_seq_cst);
+
+				// completed before available(): a pop in between can then
+				// only make the readable size look smaller.
+				auto done = _c->completed.load(std::memory_order_seq_cst);
+				auto avail = _q.available();
+				std::atomic_thread_fence(std::memory_order_acquire);
+
+				if (done > c)
+				{
+					// Released by another member since c was read.
+					continue;
+				}
+
+				if (avail <= c - done)
+				{
+					_start->store(consumer_group_idle, std::memory_order_release);
+					return claimed_batch();
+				}
+
+				size_type readable = avail - (c - done);
+				auto first = _q.data() + c % capacity;
+				size_type bytes = 0;
+				size_type records = 0;
+
+				while (records < max_records && bytes < readable)
+				{
+					auto h = reinterpret_cast<const record_header*>(first + bytes);
+					bytes += record_footprint(h->size);
+					++records;
+				}
+
+				// A header read after another member claimed it may have
+				// been overwritten; the CAS fails then anyway.
+				if (bytes <= readable &&
+					_c->claim.compare_exchange_weak(c, c + bytes, std::memory_order_acq_rel))
+				{
+					claimed_batch b;
+					b.first = reinterpret_cast<const record_header*>(first);
+					b.records = records;
+					b.bytes = bytes;
+					b.start = c;
+					return b;
+				}
+			}
+		}
+
+
+		// Marks b processed and advances rpos as far as possible.
+		void complete(const claimed_batch& b)
+		{
+			assert(_start->load(std::memory_order_relaxed) == b.start);
+			(void)b;
+			_start->store(consumer_group_idle, std::memory_order_seq_cst);
+			advance();
+		}
+
+
+	private:
+
+		// End of the processed prefix: the claim cursor, or the start of
+		// the oldest batch still held by a member.
+		std::uint64_t releasable() const noexcept
+		{
+			auto p = _c->claim.load(std::memory_order_seq_cst);
+
+			for (auto& m : _c->members)
+			{
+				p = std::min<std::uint64_t>(p, m.start.load(std::memory_order_seq_cst));
+			}
+
+			return p;
+		}
+
+
+		void advance()
+		{
+			for (;;)
+			{
+				// Whoever holds the flag re-checks after dropping it, so
+				// a member finding it taken can leave.
+				if (_c->advancing.exchange(1, std::memory_order_acquire) != 0)
+				{
+					return;
+				}
+
+				auto done = _c->completed.load(std::memory_order_relaxed);
+				auto p = releasable();
+
+				if (p > done)
+				{
+					_q.pop(p - done);
+					_c->completed.store(p, std::memory_order_seq_cst);
+					done = p;
+				}
+
+				_c->advancing.store(0, std::memory_order_seq_cst);
+				p = releasable();
+
+				if (p <= done)
+				{
+					return;
+				}
+			}
+		}
+
+
+		Q& _q;
+		consumer_group_control* _c;
+		std::atomic<std::uint64_t>* _start;
+
+	};
+
+}
+
+
+#endif
@@ -0,0 +1,280 @@
+//
+// Copyright (c) 2016 Dado Colussi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+#ifndef __gdc__delta_codec__
+#define __gdc__delta_codec__
+
+
+#include <type_traits>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <cassert>
+
+#include "gdc_framed_queue.hpp"
+
+
+// Delta encoding of fixed layout records.
+//
+// A record of type T is handled as an array of 64-bit words. Each encoded
+// record is a bitmap of the words that differ from the previous record
+// followed by the zigzag varint encoded difference of every changed word.
+// Unchanged words cost one bit.
+//
+// Encoder and decoder keep the previous record as state, so every encoded
+// record must be decoded, in order.
+
+
+namespace gdc
+{
+
+	template<typename T>
+	class delta_codec
+	{
+	public:
+
+		static_assert(
+			std::is_trivially_copyable<T>::value,
+			"T in delta_codec<T> must be trivially copyable");
+
+		typedef std::size_t size_type;
+
+		static const size_type words = (sizeof (T) + 7) / 8;
+		static const size_type bitmap_size = (words + 7) / 8;
+
+		// Upper bound of the encoded size of one record.
+		static const size_type max_size = bitmap_size + 10 * words;
+
+
+		delta_codec() noexcept
+		{
+			reset();
+		}
+
+
+		// Forgets the previous record. Encoder and decoder must be reset
+		// together.
+		void reset() noexcept
+		{
+			std::memset(_prev, 0, sizeof _prev);
+		}
+
+
+		// Encodes t into out, which must have room for max_size bytes.
+		// Returns the number of bytes written.
+		size_type encode(const T& t, void* out) noexcept
+		{
+			std::uint64_t cur[words];
+			load(t, cur);
+
+			auto bitmap = static_cast<unsigned char*>(out);
+			auto p = bitmap + bitmap_size;
+			std::memset(bitmap, 0, bitmap_size);
+
+			for (size_type i = 0; i < words; ++i)
+			{
+				if (cur[i] != _prev[i])
+				{
+					bitmap[i / 8] |= static_cast<unsigned char>(1u << (i % 8));
+					std::uint64_t d = cur[i] - _prev[i];
+					p = put_varint(zigzag(d), p);
+					_prev[i] = cur[i];
+				}
+			}
+
+			return p - static_cast<unsigned char*>(out);
+		}
+
+
+		// Decodes the record at in into t. Returns the number
+		// of bytes consumed.
+		size_type decode(const void* in, T& t) noexcept
+		{
+			auto bitmap = static_cast<const unsigned char*>(in);
+			auto p = bitmap + bitmap_size;
+
+			for (size_type i = 0; i < words; ++i)
+			{
+				if (bitmap[i / 8] & (1u << (i % 8)))
+				{
+					std::uint64_t z;
+					p = get_varint(p, z);
+					_prev[i] += unzigzag(z);
+				}
+			}
+
+			std::memcpy(&t, _prev, sizeof (T));
+			return p - static_cast<const unsigned char*>(in);
+		}
+
+	private:
+
+		static void load(const T& t, std::uint64_t* w) noexcept
+		{
+			w[words - 1] = 0;
+			std::memcpy(w, &t, sizeof (T));
+		}
+
+
+		static std::uint64_t zigzag(std::uint64_t d) noexcept
+		{
+			auto s = static_cast<std::int64_t>(d);
+			return (d << 1) ^ static_cast<std::uint64_t>(s >> 63);
+		}
+
+
+		static std::uint64_t unzigzag(std::uint64_t z) noexcept
+		{
+			return (z >> 1) ^ (~(z & 1) + 1);
+		}
+
+
+		static unsigned char* put_varint(std::uint64_t v, unsigned char* p) noexcept
+		{
+			while (v >= 0x80)
+			{
+				*p++ = static_cast<unsigned char>(v | 0x80);
+				v >>= 7;
+			}
+
+			*p++ = static_cast<unsigned char>(v);
+			return p;
+		}
+
+
+		static const unsigned char* get_varint(const unsigned char* p, std::uint64_t& v) noexcept
+		{
+			v = 0;
+
+			for (unsigned shift = 0; ; shift += 7)
+			{
+				std::uint64_t b = *p++;
+				v |= (b & 0x7f) << shift;
+
+				if (b < 0x80)
+				{
+					return p;
+				}
+			}
+		}
+
+
+		std::uint64_t _prev[words];
+
+	};
+
+
+	template<typename T>
+	const typename delta_codec<T>::size_type delta_codec<T>::words;
+
+	template<typename T>
+	const typename delta_codec<T>::size_type delta_codec<T>::bitmap_size;
+
+	template<typename T>
+	const typename delta_codec<T>::size_type delta_codec<T>::max_size;
+
+
+	// Producer side delta encoding of T records into a framed_queue<Q>.
+	template<typename Q, typename T>
+	class delta_writer
+	{
+	public:
+
+		explicit delta_writer(framed_queue<Q>& fq) noexcept :
+			_fq(fq)
+		{
+		}
+
+
+		delta_writer(const delta_writer&) = delete;
+		delta_writer& operator=(const delta_writer&) = delete;
+
+
+		bool push(const T& t)
+		{
+			auto p = _fq.alloc(delta_codec<T>::max_size);
+
+			if (p == nullptr)
+			{
+				return false;
+			}
+
+			auto n = _codec.encode(t, p);
+			_fq.commit(n, record_tag<T>::value);
+			return true;
+		}
+
+	private:
+
+		framed_queue<Q>& _fq;
+		delta_codec<T> _codec;
+
+	};
+
+
+	// Consumer side decoding of records written by delta_writer<Q,T>.
+	template<typename Q, typename T>
+	class delta_reader
+	{
+	public:
+
+		explicit delta_reader(framed_queue<Q>& fq) noexcept :
+			_fq(fq)
+		{
+		}
+
+
+		delta_reader(const delta_reader&) = delete;
+		delta_reader& operator=(const delta_reader&) = delete;
+
+
+		// Decodes and removes the first record. Returns false if the queue
+		// is empty.
+		bool pop(T& t)
+		{
+			auto h = _fq.peek();
+
+			if (h == nullptr)
+			{
+				return false;
+			}
+
+			auto n = _codec.decode(framed_queue<Q>::payload(h), t);
+			assert(n == h->size);
+			(void)n;
+			_fq.pop();
+			return true;
+		}
+
+	private:
+
+		framed_queue<Q>& _fq;
+		delta_codec<T> _codec;
+
+	};
+
+}
+
+
+#endif
@@ -0,0 +1,193 @@
+//
+// Copyright (c) 2016 Dado Colussi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+
+#ifndef __gdc__fifo_arena__
+#define __gdc__fifo_arena__
+
+
+#include <new>
+#include <cstdint>
+#include <cstddef>
+#include <cassert>
+
+#include "gdc_memory_resource.hpp"
+
+
+namespace gdc
+{
+
+	// Header of every arena slot. A slot is the header, padding for
+	// alignment, then the block handed out. The 4 bytes right before the
+	// block hold its distance from the slot start.
+	struct fifo_arena_slot
+	{
+		std::uint32_t size;
+		std::uint32_t released;
+		std::uint32_t reserved;
+		std::uint32_t offset;
+	};
+
+
+	// Memory resource over the data region of an in-process queue, for
+	// transient objects that die in roughly FIFO order. Allocation bumps
+	// the write position; deallocation marks the block and advances the
+	// read position over every released block at the head, so a block
+	// freed out of order is reclaimed once all older blocks are. Not
+	// thread safe; throws std::bad_alloc when the queue is full.
+	template<typename Q>
+	class fifo_arena : public memory_resource
+	{
+	private:
+
+		static const size_type slot_alignment = 16;
+
+
+		Q& _q;
+		size_type _outstanding;
+
+
+		static size_type align_up(size_type n, size_type a) noexcept
+		{
+			return (n + a - 1) / a * a;
+		}
+
+
+		void* do_allocate(size_type bytes, size_type alignment) override
+		{
+			assert(alignment > 0 && (alignment & (alignment - 1)) == 0);
+
+			if (alignment < slot_alignment)
+			{
+				alignment = slot_alignment;
+			}
+
+			// Reserve for the worst case padding, commit what is used. The
+			// ring is mapped twice, so the slot is always contiguous.
+			auto padding = alignment - slot_alignment;
+			auto worst = align_up(sizeof (fifo_arena_slot) + padding + bytes, slot_alignment);
+
+			if (worst >= _q.capacity())
+			{
+				throw std::bad_alloc();
+			}
+
+			auto p = reinterpret_cast<char*>(_q.alloc(worst));
+
+			if (p == nullptr)
+			{
+				throw std::bad_alloc();
+			}
+
+			auto start = reinterpret_cast<std::uintptr_t>(p);
+			auto block = align_up(start + sizeof (fifo_arena_slot), alignment);
+			auto offset = block - start;
+			auto slot = reinterpret_cast<fifo_arena_slot*>(p);
+			slot->size = align_up(offset + bytes, slot_alignment);
+			slot->released = 0;
+			reinterpret_cast<std::uint32_t*>(block)[-1] = offset;
+			_q.commit(slot->size);
+			++_outstanding;
+			return reinterpret_cast<void*>(block);
+		}
+
+
+		void do_deallocate(void* p, size_type, size_type) override
+		{
+			auto block = reinterpret_cast<char*>(p);
+			auto offset = reinterpret_cast<std::uint32_t*>(block)[-1];
+			auto slot = reinterpret_cast<fifo_arena_slot*>(block - offset);
+			assert(!slot->released);
+			slot->released = 1;
+			--_outstanding;
+			auto head = _q.peek();
+			auto avail = _q.available();
+			size_type n = 0;
+
+			// Reclaim the released blocks at the head with a single pop.
+			while (n < avail)
+			{
+				auto s = reinterpret_cast<const fifo_arena_slot*>(head + n);
+
+				if (!s->released)
+				{
+					break;
+				}
+
+				n += s->size;
+			}
+
+			if (n > 0)
+			{
+				_q.pop(n);
+			}
+		}
+
+
+		bool do_is_equal(const memory_resource& other) const noexcept override
+		{
+			return this == &other;
+		}
+
+
+	public:
+
+		explicit fifo_arena(Q& q) noexcept :
+			_q(q),
+			_outstanding(0)
+		{
+			assert(q.empty());
+		}
+
+
+		~fifo_arena()
+		{
+			assert(_outstanding == 0);
+		}
+
+
+		// Number of blocks allocated and not yet deallocated.
+		size_type outstanding() const noexcept
+		{
+			return _outstanding;
+		}
+
+
+		// Bytes of the queue held by the arena, including blocks that were
+		// released out of order and not yet reclaimed.
+		size_type used() const noexcept
+		{
+			return _q.available();
+		}
+
+	};
+
+
+	template<typename Q>
+	const typename fifo_arena<Q>::size_type fifo_arena<Q>::slot_alignment;
+
+}
+
+
+#endif
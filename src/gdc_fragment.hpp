@@ -0,0 +1,326 @@
+//
+// Copyright (c) 2016 Dado Colussi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+#ifndef __gdc__fragment__
+#define __gdc__fragment__
+
+
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <cassert>
+
+#include "gdc_circular_queue_error.hpp"
+#include "gdc_framed_queue.hpp"
+
+
+// Messages of any size over a framed_queue<Q>.
+//
+// fragment_writer splits a message into records of at most chunk_size
+// payload bytes, flagged with record_fragment. The first fragment is
+// flagged with record_first_fragment and starts with a fragment_header,
+// the last is flagged with record_last_fragment. Fragments are written as
+// space becomes available, so the consumer can reassemble the beginning
+// of a message while the producer still writes the rest.
+
+
+namespace gdc
+{
+
+	struct fragment_header
+	{
+		// Size of the whole message.
+		std::uint64_t size;
+	};
+
+
+	template<typename Q>
+	class fragment_writer
+	{
+	public:
+
+		typedef typename Q::size_type size_type;
+
+
+		// Small chunks let the consumer start earlier; chunks close to the
+		// queue capacity serialize producer and consumer.
+		fragment_writer(framed_queue<Q>& fq, size_type chunk_size) noexcept :
+			_fq(fq),
+			_chunk_size(chunk_size),
+			_data(nullptr),
+			_size(0),
+			_sent(0),
+			_tag(0)
+		{
+			assert(chunk_size > sizeof (fragment_header));
+			assert(framed_queue<Q>::footprint(chunk_size) < fq.queue().capacity());
+		}
+
+
+		fragment_writer(const fragment_writer&) = delete;
+		fragment_writer& operator=(const fragment_writer&) = delete;
+
+
+		// True while a message is being sent.
+		bool busy() const noexcept
+		{
+			return _data != nullptr;
+		}
+
+
+		// Starts sending a message of n bytes. The data must stay valid
+		// until send() returns true. Returns false if a message is already
+		// being sent.
+		bool start(const void* data, size_type n, std::uint16_t tag = 0) noexcept
+		{
+			if (busy())
+			{
+				return false;
+			}
+
+			_data = static_cast<const char*>(data);
+			_size = n;
+			_sent = 0;
+			_tag = tag;
+			return true;
+		}
+
+
+		// Writes as many fragments as there is space for. Returns true when
+		// the whole message has been written.
+		bool send()
+		{
+			while (busy())
+			{
+				bool first = _sent == 0;
+				size_type prefix = first ? sizeof (fragment_header) : 0;
+				size_type n = std::min(_chunk_size - prefix, _size - _sent);
+				auto p = static_cast<char*>(_fq.alloc(prefix + n));
+
+				if (p == nullptr)
+				{
+					return false;
+				}
+
+				std::uint16_t flags = record_fragment;
+
+				if (first)
+				{
+					fragment_header h;
+					h.size = _size;
+					std::memcpy(p, &h, sizeof h);
+					flags |= record_first_fragment;
+				}
+
+				std::memcpy(p + prefix, _data + _sent, n);
+				_sent += n;
+
+				if (_sent == _size)
+				{
+					flags |= record_last_fragment;
+					_data = nullptr;
+				}
+
+				_fq.commit(prefix + n, _tag, flags);
+			}
+
+			return true;
+		}
+
+	private:
+
+		framed_queue<Q>& _fq;
+		size_type _chunk_size;
+		const char* _data;
+		size_type _size;
+		size_type _sent;
+		std::uint16_t _tag;
+
+	};
+
+
+	// Reassembles messages written by fragment_writer<Q> into a caller
+	// buffer. Unfragmented records are returned as single messages.
+	template<typename Q>
+	class fragment_reader
+	{
+	public:
+
+		typedef typename Q::size_type size_type;
+
+
+		explicit fragment_reader(framed_queue<Q>& fq) noexcept :
+			_fq(fq),
+			_busy(false),
+			_size(0),
+			_received(0),
+			_tag(0)
+		{
+		}
+
+
+		fragment_reader(const fragment_reader&) = delete;
+		fragment_reader& operator=(const fragment_reader&) = delete;
+
+
+		// Size of the message being reassembled or of the next message in
+		// the queue. Returns 0 if unknown. Not const: peeking may release
+		// records popped in a batch.
+		size_type message_size()
+		{
+			if (_busy)
+			{
+				return _size;
+			}
+
+			auto h = _fq.peek();
+			return h != nullptr ? message_size(h) : 0;
+		}
+
+
+		// Size and tag of the last completed message.
+		size_type size() const noexcept
+		{
+			return _size;
+		}
+
+
+		std::uint16_t tag() const noexcept
+		{
+			return _tag;
+		}
+
+
+		// Consumes available fragments into buf. Returns true when a whole
+		// message is in buf. Pass the same buffer until then. Throws
+		// circular_queue_error without consuming anything if the next
+		// message is larger than capacity. Also throws if the fragments
+		// are malformed or do not add up to the message size.
+		bool read(void* buf, size_type capacity)
+		{
+			auto out = static_cast<char*>(buf);
+
+			while (auto h = _fq.peek())
+			{
+				auto p = static_cast<const char*>(framed_queue<Q>::payload(h));
+				size_type n = h->size;
+
+				if (!_busy)
+				{
+					if ((h->flags & record_first_fragment) && n < sizeof (fragment_header))
+					{
+						throw circular_queue_error("fragment_reader: truncated first fragment");
+					}
+
+					if (message_size(h) > capacity)
+					{
+						throw circular_queue_error("fragment_reader: message too large");
+					}
+
+					_tag = h->tag;
+					_received = 0;
+
+					if (!(h->flags & record_fragment))
+					{
+						_size = n;
+						std::memcpy(out, p, n);
+						_fq.pop();
+						return true;
+					}
+
+					if (!(h->flags & record_first_fragment))
+					{
+						throw circular_queue_error("fragment_reader: missing first fragment");
+					}
+
+					_size = message_size(h);
+					_busy = true;
+					p += sizeof (fragment_header);
+					n -= sizeof (fragment_header);
+				}
+				else if (!(h->flags & record_fragment) || (h->flags & record_first_fragment))
+				{
+					throw circular_queue_error("fragment_reader: missing last fragment");
+				}
+
+				if (n > _size - _received)
+				{
+					throw circular_queue_error("fragment_reader: fragments exceed message size");
+				}
+
+				std::memcpy(out + _received, p, n);
+				_received += n;
+				bool last = h->flags & record_last_fragment;
+				_fq.pop();
+
+				if (last)
+				{
+					_busy = false;
+
+					if (_received != _size)
+					{
+						throw circular_queue_error("fragment_reader: fragments short of message size");
+					}
+
+					return true;
+				}
+			}
+
+			return false;
+		}
+
+	private:
+
+		// Size of the message starting with the record at h.
+		static size_type message_size(const record_header* h) noexcept
+		{
+			if (h->flags & record_fragment)
+			{
+				if (h->size < sizeof (fragment_header))
+				{
+					return 0;
+				}
+
+				fragment_header fh;
+				std::memcpy(&fh, framed_queue<Q>::payload(h), sizeof fh);
+				return fh.size;
+			}
+
+			return h->size;
+		}
+
+
+		framed_queue<Q>& _fq;
+		bool _busy;
+		size_type _size;
+		size_type _received;
+		std::uint16_t _tag;
+
+	};
+
+}
+
+
+#endif
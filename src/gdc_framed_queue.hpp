@@ -0,0 +1,704 @@
+//
+// Copyright (c) 2016 Dado Colussi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+#ifndef __gdc__framed_queue__
+#define __gdc__framed_queue__
+
+
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <atomic>
+#include <new>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <cassert>
+
+#include "gdc_clock.hpp"
+
+
+// Record framing on top of a byte queue (circular_queue<char>).
+//
+// Every record is a record_header followed by the payload, padded to
+// framed_queue<Q>::alignment bytes. The queue capacity must be a multiple
+// of the alignment so that every record header stays aligned.
+//
+// Include either gdc_circular_queue.hpp or gdc_circular_queue.h before
+// instantiating framed_queue<Q>.
+//
+// Optional producer features attach through the hook parameter H of
+// framed_queue<Q, H>, e.g. sequence_hook in gdc_sequencer.hpp. The
+// default no_record_hook compiles away.
+
+
+namespace gdc
+{
+
+	struct record_header
+	{
+		// Payload length in bytes. Excludes the header and padding.
+		std::uint32_t size;
+
+		// Application defined record type.
+		std::uint16_t tag;
+
+		// Framing layer flags.
+		std::uint16_t flags;
+
+		// clock_ns() at commit if the producer stamps records, otherwise 0.
+		std::uint64_t timestamp;
+
+		// Global sequence number if the producer has a sequence_hook,
+		// otherwise 0.
+		std::uint64_t sequence;
+	};
+
+
+	// record_header::flags of fragmented messages. See gdc_fragment.hpp.
+	const std::uint16_t record_fragment = 1;
+	const std::uint16_t record_first_fragment = 2;
+	const std::uint16_t record_last_fragment = 4;
+
+
+	const std::size_t record_alignment = 8;
+
+
+	// Bytes taken in the queue by a record with nbytes of payload.
+	constexpr std::size_t record_footprint(std::size_t nbytes) noexcept
+	{
+		return (sizeof (record_header) + nbytes + record_alignment - 1) /
+			record_alignment * record_alignment;
+	}
+
+
+	// Tag of records of type U created with framed_queue<Q>::emplace()
+	// and framed_queue<Q>::build(). Specialize for typed records.
+	template<typename U>
+	struct record_tag
+	{
+		static const std::uint16_t value = 0;
+	};
+
+
+	// Set of record tags for framed_queue<Q>::peek_matching(). One bit per
+	// tag, so testing a header costs one load.
+	class tag_filter
+	{
+	public:
+
+		tag_filter() :
+			_bits(65536 / 64, 0)
+		{
+		}
+
+
+		tag_filter& add(std::uint16_t tag)
+		{
+			_bits[tag / 64] |= std::uint64_t(1) << (tag % 64);
+			return *this;
+		}
+
+
+		tag_filter& remove(std::uint16_t tag)
+		{
+			_bits[tag / 64] &= ~(std::uint64_t(1) << (tag % 64));
+			return *this;
+		}
+
+
+		bool contains(std::uint16_t tag) const noexcept
+		{
+			return (_bits[tag / 64] >> (tag % 64)) & 1;
+		}
+
+
+	private:
+
+		std::vector<std::uint64_t> _bits;
+
+	};
+
+
+	// Returns the trailing array of a record of type U.
+	template<typename E, typename U>
+	const E* trailing(const U* p) noexcept
+	{
+		return reinterpret_cast<const E*>(p + 1);
+	}
+
+
+	// Producer hook of framed_queue<Q, H> that does nothing. Hooks derive
+	// from it and override what they need.
+	struct no_record_hook
+	{
+		// Whether a record of footprint bytes may be allocated. alloc()
+		// returns nullptr, as for a full queue, if not.
+		bool admit(std::size_t footprint) noexcept
+		{
+			(void)footprint;
+			return true;
+		}
+
+
+		// Called by commit() with the complete header, before the record
+		// is published. offset is the position of h in the queue.
+		void commit(record_header& h, std::size_t offset) noexcept
+		{
+			(void)h;
+			(void)offset;
+		}
+
+
+		// Copies a payload in push().
+		void copy(void* dst, const void* src, std::size_t n)
+		{
+			std::memcpy(dst, src, n);
+		}
+	};
+
+
+	template<typename Q, typename H = no_record_hook>
+	class framed_queue;
+
+
+	// Builds a record of type U followed by a trailing array of E in place.
+	// Nothing is published unless commit() is called.
+	template<typename Q, typename U, typename E, typename H = no_record_hook>
+	class record_builder
+	{
+	public:
+
+		typedef typename Q::size_type size_type;
+
+
+		record_builder(framed_queue<Q, H>* fq, U* p, size_type count) noexcept :
+			_fq(fq),
+			_p(p),
+			_count(count)
+		{
+		}
+
+
+		record_builder(record_builder&& b) noexcept :
+			_fq(b._fq),
+			_p(b._p),
+			_count(b._count)
+		{
+			b._p = nullptr;
+		}
+
+
+		record_builder(const record_builder&) = delete;
+		record_builder& operator=(const record_builder&) = delete;
+		record_builder& operator=(record_builder&&) = delete;
+
+
+		explicit operator bool() const noexcept
+		{
+			return _p != nullptr;
+		}
+
+
+		U* get() const noexcept
+		{
+			return _p;
+		}
+
+
+		U* operator->() const noexcept
+		{
+			return _p;
+		}
+
+
+		U& operator*() const noexcept
+		{
+			return *_p;
+		}
+
+
+		E* trailing() const noexcept
+		{
+			return reinterpret_cast<E*>(_p + 1);
+		}
+
+
+		size_type capacity() const noexcept
+		{
+			return _count;
+		}
+
+
+		// Publishes the record with count trailing elements.
+		void commit(size_type count)
+		{
+			assert(_p != nullptr);
+			assert(count <= _count);
+			_fq->commit(sizeof (U) + count * sizeof (E), record_tag<U>::value);
+			_p = nullptr;
+		}
+
+
+		void commit()
+		{
+			commit(_count);
+		}
+
+	private:
+
+		framed_queue<Q, H>* _fq;
+		U* _p;
+		size_type _count;
+
+	};
+
+
+	template<typename Q, typename H>
+	class framed_queue
+	{
+	public:
+
+		typedef Q queue_type;
+		typedef H hook_type;
+		typedef typename Q::size_type size_type;
+
+		static const size_type alignment = record_alignment;
+
+
+		static constexpr size_type footprint(size_type nbytes) noexcept
+		{
+			return record_footprint(nbytes);
+		}
+
+
+		// Records are stamped with clock_ns() at commit if stamp is true.
+		explicit framed_queue(Q& q, bool stamp = false, H hook = H()) noexcept :
+			_q(q),
+			_hook(hook),
+			_pending(nullptr),
+			_pending_size(0),
+			_stamp(stamp),
+			_publish_batch(1),
+			_unpublished(0),
+			_unpublished_bytes(0),
+			_unpublished_since(0),
+			_committed(0),
+			_release_batch(1),
+			_unreleased(0),
+			_unreleased_bytes(0),
+			_popped(0),
+			_skipped(0)
+		{
+			static_assert(
+				sizeof (typename Q::value_type) == 1,
+				"Q in framed_queue<Q> must be a byte queue");
+			static_assert(
+				sizeof (record_header) % alignment == 0,
+				"record_header must preserve record alignment");
+			assert(q.capacity() % alignment == 0);
+		}
+
+
+		framed_queue(const framed_queue&) = delete;
+		framed_queue& operator=(const framed_queue&) = delete;
+
+
+		Q& queue() noexcept
+		{
+			return _q;
+		}
+
+
+		H& hook() noexcept
+		{
+			return _hook;
+		}
+
+
+		// Producer side: records are made visible to the consumer every
+		// batch commits, or at publish(). A producer batching records must
+		// call publish() when it goes idle, e.g. through publish_tuner.
+		void set_publish_batch(size_type records)
+		{
+			assert(records > 0);
+			_publish_batch = records;
+
+			if (_unpublished >= records)
+			{
+				publish();
+			}
+		}
+
+
+		size_type publish_batch() const noexcept
+		{
+			return _publish_batch;
+		}
+
+
+		// Makes all committed records visible to the consumer.
+		void publish()
+		{
+			if (_unpublished_bytes > 0)
+			{
+				_q.commit(_unpublished_bytes);
+				_unpublished = 0;
+				_unpublished_bytes = 0;
+			}
+		}
+
+
+		// Committed records not yet published, and the clock_ns() of the
+		// first of them.
+		size_type unpublished() const noexcept
+		{
+			return _unpublished;
+		}
+
+
+		std::uint64_t unpublished_since() const noexcept
+		{
+			return _unpublished_since;
+		}
+
+
+		std::uint64_t records_committed() const noexcept
+		{
+			return _committed;
+		}
+
+
+		// Consumer side: the space of popped records is handed back to the
+		// producer every batch pops, at release(), or when peek() finds
+		// nothing new.
+		void set_release_batch(size_type records)
+		{
+			assert(records > 0);
+			_release_batch = records;
+
+			if (_unreleased >= records)
+			{
+				release();
+			}
+		}
+
+
+		size_type release_batch() const noexcept
+		{
+			return _release_batch;
+		}
+
+
+		// Hands the space of all popped records back to the producer.
+		void release()
+		{
+			if (_unreleased_bytes > 0)
+			{
+				_q.pop(_unreleased_bytes);
+				_unreleased = 0;
+				_unreleased_bytes = 0;
+			}
+		}
+
+
+		size_type unreleased() const noexcept
+		{
+			return _unreleased;
+		}
+
+
+		std::uint64_t records_popped() const noexcept
+		{
+			return _popped;
+		}
+
+
+		// Records passed over by peek_matching(). Not counted as popped.
+		std::uint64_t records_skipped() const noexcept
+		{
+			return _skipped;
+		}
+
+
+		// Whether there is no record to pop. Reads consumer side state,
+		// so other threads should call it on their own framed_queue.
+		bool empty() const noexcept
+		{
+			return _q.available() <= _unreleased_bytes;
+		}
+
+
+		// Returns the payload address of a new record of at most nbytes,
+		// or nullptr if the queue is full or the hook refuses the record.
+		void* alloc(size_type nbytes)
+		{
+			if (!_hook.admit(footprint(nbytes)))
+			{
+				publish();
+				return nullptr;
+			}
+
+			auto n = _unpublished_bytes + footprint(nbytes);
+
+			if (n >= _q.capacity())
+			{
+				publish();
+				n = footprint(nbytes);
+			}
+
+			auto p = reinterpret_cast<char*>(_q.alloc(n));
+
+			if (p == nullptr)
+			{
+				// Let the consumer drain what is held back.
+				publish();
+				return nullptr;
+			}
+
+			_pending = reinterpret_cast<record_header*>(p + _unpublished_bytes);
+			_pending_size = nbytes;
+			return _pending + 1;
+		}
+
+
+		// Publishes the record returned by the last alloc().
+		void commit(size_type nbytes, std::uint16_t tag = 0, std::uint16_t flags = 0)
+		{
+			assert(_pending != nullptr);
+			assert(nbytes <= _pending_size);
+			_pending->size = static_cast<std::uint32_t>(nbytes);
+			_pending->tag = tag;
+			_pending->flags = flags;
+			_pending->timestamp = _stamp ? clock_ns() : 0;
+			_pending->sequence = 0;
+			_hook.commit(*_pending, reinterpret_cast<const char*>(_pending) - _q.data());
+			_pending = nullptr;
+			++_committed;
+
+			if (_unpublished == 0 && _publish_batch > 1)
+			{
+				_unpublished_since = clock_ns();
+			}
+
+			_unpublished_bytes += footprint(nbytes);
+
+			if (++_unpublished >= _publish_batch)
+			{
+				publish();
+			}
+		}
+
+
+		bool push(const void* data, size_type nbytes, std::uint16_t tag = 0)
+		{
+			auto p = alloc(nbytes);
+
+			if (p == nullptr)
+			{
+				return false;
+			}
+
+			_hook.copy(p, data, nbytes);
+			commit(nbytes, tag);
+			return true;
+		}
+
+
+		// Constructs a U in place in the queue and publishes it.
+		template<typename U, typename... Args>
+		bool emplace(Args&&... args)
+		{
+			static_assert(
+				std::is_trivially_copyable<U>::value,
+				"U in framed_queue<Q>::emplace<U>() must be trivially copyable");
+			static_assert(
+				alignof (U) <= alignment,
+				"U in framed_queue<Q>::emplace<U>() is over-aligned");
+
+			auto p = alloc(sizeof (U));
+
+			if (p == nullptr)
+			{
+				return false;
+			}
+
+			new (p) U(std::forward<Args>(args)...);
+			commit(sizeof (U), record_tag<U>::value);
+			return true;
+		}
+
+
+		// Constructs a U followed by room for count elements of E in place.
+		// Check the returned builder before use; it is empty if the queue
+		// is full.
+		template<typename U, typename E, typename... Args>
+		record_builder<Q, U, E, H> build(size_type count, Args&&... args)
+		{
+			static_assert(
+				std::is_trivially_copyable<U>::value &&
+				std::is_trivially_copyable<E>::value,
+				"U and E in framed_queue<Q>::build<U,E>() must be trivially copyable");
+			static_assert(
+				alignof (U) <= alignment && sizeof (U) % alignof (E) == 0,
+				"E in framed_queue<Q>::build<U,E>() would be misaligned");
+
+			auto p = alloc(sizeof (U) + count * sizeof (E));
+
+			if (p == nullptr)
+			{
+				return record_builder<Q, U, E, H>(this, nullptr, 0);
+			}
+
+			auto u = new (p) U(std::forward<Args>(args)...);
+			return record_builder<Q, U, E, H>(this, u, count);
+		}
+
+
+		// Returns the header of the first record, or nullptr if the queue
+		// is empty.
+		const record_header* peek()
+		{
+			if (_unreleased_bytes == 0)
+			{
+				return reinterpret_cast<const record_header*>(_q.peek());
+			}
+
+			if (_q.available() <= _unreleased_bytes)
+			{
+				release();
+				return nullptr;
+			}
+
+			std::atomic_thread_fence(std::memory_order_acquire);
+			auto p = _q.peek() + _unreleased_bytes;
+			return reinterpret_cast<const record_header*>(p);
+		}
+
+
+		static const void* payload(const record_header* h) noexcept
+		{
+			return h + 1;
+		}
+
+
+		template<typename U>
+		static const U* payload(const record_header* h) noexcept
+		{
+			assert(h->size >= sizeof (U));
+			return reinterpret_cast<const U*>(h + 1);
+		}
+
+
+		// Removes the first record.
+		void pop()
+		{
+			auto h = peek();
+			assert(h != nullptr);
+			++_popped;
+			_unreleased_bytes += footprint(h->size);
+
+			if (++_unreleased >= _release_batch)
+			{
+				release();
+			}
+		}
+
+
+		// Returns the first record with a tag in filter, or nullptr if
+		// there is none, like peek(). Records before it are removed
+		// without returning to the caller, and their space goes back to
+		// the producer with one rpos update, subject to the release batch.
+		const record_header* peek_matching(const tag_filter& filter)
+		{
+			auto avail = _q.available();
+
+			if (avail <= _unreleased_bytes)
+			{
+				release();
+				return nullptr;
+			}
+
+			std::atomic_thread_fence(std::memory_order_acquire);
+			auto first = reinterpret_cast<const char*>(_q.peek());
+			auto offset = _unreleased_bytes;
+			const record_header* match = nullptr;
+			size_type skipped = 0;
+
+			// Each header's position depends on the size of the one
+			// before, so this is a pointer chase with a bit test per hop.
+			while (offset < avail)
+			{
+				auto h = reinterpret_cast<const record_header*>(first + offset);
+
+				if (filter.contains(h->tag))
+				{
+					match = h;
+					break;
+				}
+
+				offset += footprint(h->size);
+				++skipped;
+			}
+
+			_skipped += skipped;
+			_unreleased_bytes = offset;
+			_unreleased += skipped;
+
+			if (match == nullptr || _unreleased >= _release_batch)
+			{
+				release();
+			}
+
+			return match;
+		}
+
+	private:
+
+		Q& _q;
+		H _hook;
+		record_header* _pending;
+		size_type _pending_size;
+		bool _stamp;
+		size_type _publish_batch;
+		size_type _unpublished;
+		size_type _unpublished_bytes;
+		std::uint64_t _unpublished_since;
+		std::uint64_t _committed;
+		size_type _release_batch;
+		size_type _unreleased;
+		size_type _unreleased_bytes;
+		std::uint64_t _popped;
+		std::uint64_t _skipped;
+
+	};
+
+
+	template<typename Q, typename H>
+	const typename framed_queue<Q, H>::size_type framed_queue<Q, H>::alignment;
+
+}
+
+
+#endif
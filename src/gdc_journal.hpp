@@ -0,0 +1,469 @@
+//
+// Copyright (c) 2016 Dado Colussi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+#ifndef __gdc__journal__
+#define __gdc__journal__
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include <memory>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <cerrno>
+#include <cassert>
+
+#include "gdc_circular_queue_error.hpp"
+#include "gdc_framed_queue.hpp"
+#include "gdc_block_codec.hpp"
+
+
+// Journal files of framed records.
+//
+// journal_writer drains records from a framed_queue<Q> into blocks of
+// about block_size bytes. Each block is compressed with a block_codec and
+// written as a journal_block_header followed by the compressed bytes.
+// Blocks that don't compress are stored as they are. Records keep their
+// record_header framing inside blocks.
+
+
+namespace gdc
+{
+
+	struct journal_block_header
+	{
+		std::uint32_t magic;
+
+		// block_codec::id() of the codec that compressed the block.
+		std::uint32_t codec;
+
+		// Size of the block before and after compression.
+		std::uint32_t raw_size;
+		std::uint32_t size;
+
+		std::uint32_t records;
+		std::uint32_t reserved;
+	};
+
+
+	namespace detail
+	{
+		const std::uint32_t journal_magic = 0x4a434447;
+
+
+		inline circular_queue_error journal_error(const char* what)
+		{
+			std::string s(what);
+			s.append(": ");
+			s.append(::strerror(errno));
+			return circular_queue_error(s);
+		}
+	}
+
+
+	template<typename Q>
+	class journal_writer
+	{
+	public:
+
+		typedef typename Q::size_type size_type;
+
+
+		journal_writer(
+			framed_queue<Q>& fq,
+			const std::string& path,
+			std::shared_ptr<const block_codec> codec = std::make_shared<lz_codec>(),
+			size_type block_size = 64 * 1024) :
+			_fq(fq),
+			_codec(codec),
+			_block_size(block_size),
+			_block_records(0),
+			_records(0),
+			_bytes_in(0),
+			_bytes_out(0)
+		{
+			assert(_codec);
+			assert(block_size > 0);
+			_fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+
+			if (_fd == -1)
+			{
+				throw detail::journal_error("open");
+			}
+
+			_block.reserve(block_size);
+		}
+
+
+		journal_writer(const journal_writer&) = delete;
+		journal_writer& operator=(const journal_writer&) = delete;
+
+
+		~journal_writer()
+		{
+			try
+			{
+				flush();
+			}
+			catch (const circular_queue_error&)
+			{
+				// Nowhere to report it.
+			}
+
+			::close(_fd);
+		}
+
+
+		// Moves all available records from the queue to the journal.
+		// Returns the number of records moved.
+		size_type drain()
+		{
+			size_type n = 0;
+
+			while (auto h = _fq.peek())
+			{
+				auto len = record_footprint(h->size);
+
+				if (!_block.empty() && _block.size() + len > _block_size)
+				{
+					write_block();
+				}
+
+				auto p = reinterpret_cast<const char*>(h);
+				_block.insert(_block.end(), p, p + len);
+				_fq.pop();
+				++_block_records;
+				++n;
+			}
+
+			return n;
+		}
+
+
+		// Writes the pending block, if any.
+		void flush()
+		{
+			if (!_block.empty())
+			{
+				write_block();
+			}
+		}
+
+
+		size_type records() const noexcept
+		{
+			return _records;
+		}
+
+
+		// Uncompressed bytes written.
+		size_type bytes_in() const noexcept
+		{
+			return _bytes_in;
+		}
+
+
+		// Bytes written to the file, including block headers.
+		size_type bytes_out() const noexcept
+		{
+			return _bytes_out;
+		}
+
+	private:
+
+		void write_block()
+		{
+			auto raw = _block.size();
+			auto hs = sizeof (journal_block_header);
+			_out.resize(hs + _codec->max_compressed_size(raw));
+			auto z = _codec->compress(_block.data(), raw, &_out[hs], _out.size() - hs);
+
+			journal_block_header h;
+			h.magic = detail::journal_magic;
+			h.codec = _codec->id();
+			h.raw_size = static_cast<std::uint32_t>(raw);
+			h.reserved = 0;
+			h.records = _block_records;
+
+			if (z == 0 || z >= raw)
+			{
+				// Incompressible.
+				std::memcpy(&_out[hs], _block.data(), raw);
+				h.codec = null_codec::codec_id;
+				z = raw;
+			}
+
+			h.size = static_cast<std::uint32_t>(z);
+			std::memcpy(&_out[0], &h, hs);
+			write_all(_out.data(), hs + z);
+
+			_records += _block_records;
+			_bytes_in += raw;
+			_bytes_out += hs + z;
+			_block.clear();
+			_block_records = 0;
+		}
+
+
+		void write_all(const char* p, size_type n)
+		{
+			while (n > 0)
+			{
+				auto w = ::write(_fd, p, n);
+
+				if (w == -1)
+				{
+					if (errno == EINTR)
+					{
+						continue;
+					}
+
+					throw detail::journal_error("write");
+				}
+
+				p += w;
+				n -= w;
+			}
+		}
+
+
+		framed_queue<Q>& _fq;
+		std::shared_ptr<const block_codec> _codec;
+		size_type _block_size;
+		std::vector<char> _block;
+		std::vector<char> _out;
+		std::uint32_t _block_records;
+		size_type _records;
+		size_type _bytes_in;
+		size_type _bytes_out;
+		int _fd;
+
+	};
+
+
+	class journal_reader
+	{
+	public:
+
+		typedef std::size_t size_type;
+
+
+		// Reads blocks written with null_codec or lz_codec. Use add_codec()
+		// for other codecs.
+		explicit journal_reader(const std::string& path) :
+			_pos(0)
+		{
+			_codecs.push_back(std::make_shared<null_codec>());
+			_codecs.push_back(std::make_shared<lz_codec>());
+			_fd = ::open(path.c_str(), O_RDONLY);
+
+			if (_fd == -1)
+			{
+				throw detail::journal_error("open");
+			}
+		}
+
+
+		journal_reader(const journal_reader&) = delete;
+		journal_reader& operator=(const journal_reader&) = delete;
+
+
+		~journal_reader()
+		{
+			::close(_fd);
+		}
+
+
+		void add_codec(std::shared_ptr<const block_codec> codec)
+		{
+			_codecs.push_back(codec);
+		}
+
+
+		// Returns the next record, or nullptr at the end of the journal.
+		// The record is valid until the next call.
+		const record_header* next()
+		{
+			while (_pos == _block.size())
+			{
+				if (!read_block())
+				{
+					return nullptr;
+				}
+			}
+
+			if (_block.size() - _pos < sizeof (record_header))
+			{
+				throw circular_queue_error("journal: truncated record");
+			}
+
+			auto h = reinterpret_cast<const record_header*>(&_block[_pos]);
+			auto len = record_footprint(h->size);
+
+			if (len > _block.size() - _pos)
+			{
+				throw circular_queue_error("journal: truncated record");
+			}
+
+			_pos += len;
+			return h;
+		}
+
+	private:
+
+		bool read_block()
+		{
+			journal_block_header h;
+
+			if (!read_all(reinterpret_cast<char*>(&h), sizeof h))
+			{
+				return false;
+			}
+
+			if (h.magic != detail::journal_magic)
+			{
+				throw circular_queue_error("journal: bad block header");
+			}
+
+			// Both sizes come from the file. Check them before allocating.
+			if (h.size > remaining())
+			{
+				throw circular_queue_error("journal: truncated block");
+			}
+
+			auto codec = find_codec(h.codec);
+
+			if (h.raw_size > codec->max_decompressed_size(h.size))
+			{
+				throw circular_queue_error("journal: corrupt block");
+			}
+
+			_in.resize(h.size);
+
+			if (!read_all(_in.data(), h.size))
+			{
+				throw circular_queue_error("journal: truncated block");
+			}
+
+			_block.resize(h.raw_size);
+			auto n = codec->decompress(_in.data(), h.size, _block.data(), h.raw_size);
+
+			if (n == block_codec::decompress_error || n != h.raw_size)
+			{
+				throw circular_queue_error("journal: corrupt block");
+			}
+
+			_pos = 0;
+			return true;
+		}
+
+
+		// Bytes between the read offset and the end of the file.
+		size_type remaining() const
+		{
+			struct stat st;
+
+			if (::fstat(_fd, &st) == -1)
+			{
+				throw detail::journal_error("fstat");
+			}
+
+			auto pos = ::lseek(_fd, 0, SEEK_CUR);
+
+			if (pos == -1)
+			{
+				throw detail::journal_error("lseek");
+			}
+
+			return st.st_size > pos ? st.st_size - pos : 0;
+		}
+
+
+		const block_codec* find_codec(std::uint32_t id) const
+		{
+			for (auto& c : _codecs)
+			{
+				if (c->id() == id)
+				{
+					return c.get();
+				}
+			}
+
+			throw circular_queue_error("journal: unknown codec");
+		}
+
+
+		// Returns false at end of file before the first byte.
+		bool read_all(char* p, size_type n)
+		{
+			size_type done = 0;
+
+			while (done < n)
+			{
+				auto r = ::read(_fd, p + done, n - done);
+
+				if (r == -1)
+				{
+					if (errno == EINTR)
+					{
+						continue;
+					}
+
+					throw detail::journal_error("read");
+				}
+
+				if (r == 0)
+				{
+					if (done == 0)
+					{
+						return false;
+					}
+
+					throw circular_queue_error("journal: truncated block");
+				}
+
+				done += r;
+			}
+
+			return true;
+		}
+
+
+		std::vector<std::shared_ptr<const block_codec>> _codecs;
+		std::vector<char> _in;
+		std::vector<char> _block;
+		size_type _pos;
+		int _fd;
+
+	};
+
+}
+
+
+#endif
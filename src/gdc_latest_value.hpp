@@ -0,0 +1,213 @@
+//
+// Copyright (c) 2016 Dado Colussi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+
+#ifndef __gdc__latest_value__
+#define __gdc__latest_value__
+
+
+#include <type_traits>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <unistd.h>
+
+#include "gdc_circular_queue_error.hpp"
+
+
+#ifndef LEVEL1_DCACHE_LINESIZE
+#define LEVEL1_DCACHE_LINESIZE 64
+#endif
+
+
+namespace gdc
+{
+
+	// Control words of a latest_value, kept in the queue metadata.
+	struct latest_value_control
+	{
+		union
+		{
+			// Index of the middle slot, plus latest_value_fresh when it
+			// holds a snapshot the reader hasn't taken yet.
+			std::atomic<std::uint32_t> state;
+			char pad_state[LEVEL1_DCACHE_LINESIZE];
+		};
+
+		union
+		{
+			// Slot being written. Producer only.
+			std::uint32_t back;
+			char pad_back[LEVEL1_DCACHE_LINESIZE];
+		};
+
+		union
+		{
+			// Slot being read, and whether it holds a snapshot at all.
+			// Consumer only.
+			struct
+			{
+				std::uint32_t front;
+				std::uint32_t valid;
+			} reader;
+			char pad_front[LEVEL1_DCACHE_LINESIZE];
+		};
+	};
+
+
+	const std::uint32_t latest_value_fresh = 4;
+
+
+	// Latest-value triple buffer over a queue created by either factory,
+	// for state where only the most recent snapshot matters. Publishing
+	// and reading are both wait-free; intermediate snapshots are dropped.
+	// There is one producer and one consumer; see typed_metadata for a
+	// single-writer, many-readers alternative.
+	//
+	// Create the queue with capacity() bytes and init as the metadata
+	// initializer, then attach a latest_value on each side.
+	template<typename T, typename Q>
+	class latest_value
+	{
+	public:
+
+		typedef std::size_t size_type;
+
+
+	private:
+
+		static const size_type slot_size =
+			(sizeof (T) + LEVEL1_DCACHE_LINESIZE - 1) /
+			LEVEL1_DCACHE_LINESIZE * LEVEL1_DCACHE_LINESIZE;
+
+
+		latest_value_control* _c;
+		char* _slots;
+
+
+		T* slot(std::uint32_t i) const noexcept
+		{
+			return reinterpret_cast<T*>(_slots + i * slot_size);
+		}
+
+
+	public:
+
+		// Queue capacity to create the queue with.
+		static size_type capacity()
+		{
+			static long page_size = ::sysconf(_SC_PAGESIZE);
+			size_type n = 3 * slot_size;
+			return ((n - 1) / page_size + 1) * page_size;
+		}
+
+
+		// Metadata initializer for the queue.
+		static int init(Q& q)
+		{
+			if (q.metadata_size() < sizeof (latest_value_control))
+			{
+				return -1;
+			}
+
+			auto c = reinterpret_cast<latest_value_control*>(q.metadata());
+			c->back = 0;
+			c->reader.front = 2;
+			c->reader.valid = 0;
+			c->state.store(1, std::memory_order_release);
+			return 0;
+		}
+
+
+		// Throws if the queue is too small to hold the slots.
+		explicit latest_value(Q& q) :
+			_c(reinterpret_cast<latest_value_control*>(q.metadata())),
+			_slots(const_cast<char*>(q.data()))
+		{
+			static_assert(
+				std::is_trivially_copyable<T>::value,
+				"T in latest_value<T,Q> must be trivially copyable");
+
+			if (q.capacity() < 3 * slot_size)
+			{
+				throw circular_queue_error("Queue too small for latest_value.");
+			}
+		}
+
+
+		// Slot to fill before calling publish(). Producer only.
+		T& next() noexcept
+		{
+			return *slot(_c->back);
+		}
+
+
+		// Makes the content of next() the newest snapshot. Producer only.
+		void publish() noexcept
+		{
+			auto s = _c->back | latest_value_fresh;
+			auto old = _c->state.exchange(s, std::memory_order_acq_rel);
+			_c->back = old & 3;
+		}
+
+
+		void publish(const T& value) noexcept
+		{
+			std::memcpy(&next(), &value, sizeof (T));
+			publish();
+		}
+
+
+		// Whether a snapshot newer than the last read is available.
+		bool fresh() const noexcept
+		{
+			return _c->state.load(std::memory_order_relaxed) & latest_value_fresh;
+		}
+
+
+		// Returns the newest complete snapshot, or nullptr if nothing was
+		// published yet. It stays valid until the next read(). Consumer only.
+		const T* read() noexcept
+		{
+			if (fresh())
+			{
+				auto old = _c->state.exchange(_c->reader.front, std::memory_order_acq_rel);
+				_c->reader.front = old & 3;
+				_c->reader.valid = 1;
+			}
+
+			return _c->reader.valid ? slot(_c->reader.front) : nullptr;
+		}
+
+	};
+
+
+	template<typename T, typename Q>
+	const typename latest_value<T, Q>::size_type latest_value<T, Q>::slot_size;
+
+}
+
+
+#endif
@@ -0,0 +1,506 @@
+//
+// Copyright (c) 2016 Dado Colussi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+
+#ifndef __gdc__load_generator__
+#define __gdc__load_generator__
+
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <random>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+
+#include "gdc_circular_queue_error.hpp"
+#include "gdc_clock.hpp"
+#include "gdc_framed_queue.hpp"
+
+
+// Synthetic producer load for benchmarks: record sizes drawn from a
+// distribution, sent on an open-loop schedule at a target rate, in bursts
+// and on/off periods.
+
+
+namespace gdc
+{
+
+	// Payload prefix of every generated record. intended_ns is the
+	// clock_ns() the schedule wanted the record sent at, so that consumers
+	// can measure latency without coordinated omission.
+	struct load_record
+	{
+		std::uint64_t sequence;
+		std::uint64_t intended_ns;
+	};
+
+
+	class size_distribution
+	{
+	public:
+
+		typedef std::size_t size_type;
+
+
+		static size_distribution fixed(size_type n)
+		{
+			return uniform(n, n);
+		}
+
+
+		static size_distribution uniform(size_type lo, size_type hi)
+		{
+			if (lo > hi)
+			{
+				throw circular_queue_error("Empty uniform size range");
+			}
+
+			size_distribution d;
+			d._lo = lo;
+			d._hi = hi;
+			return d;
+		}
+
+
+		// Sizes with relative weights, e.g. a histogram of production
+		// traffic.
+		static size_distribution empirical(const std::vector<std::pair<size_type, double>>& weights)
+		{
+			size_distribution d;
+			double sum = 0;
+
+			for (auto& w : weights)
+			{
+				if (w.second < 0)
+				{
+					throw circular_queue_error("Negative size weight");
+				}
+
+				if (w.second > 0)
+				{
+					sum += w.second;
+					d._sizes.push_back(w.first);
+					d._cumulative.push_back(sum);
+				}
+			}
+
+			if (sum == 0)
+			{
+				throw circular_queue_error("Empty empirical size distribution");
+			}
+
+			return d;
+		}
+
+
+		// Reads lines of "size [weight]". The weight defaults to 1, so a
+		// file of raw sizes works as a sample. Blank lines and lines
+		// starting with # are ignored.
+		static size_distribution from_file(const std::string& path)
+		{
+			std::ifstream in(path);
+
+			if (!in)
+			{
+				throw circular_queue_error("Failed to open " + path);
+			}
+
+			std::vector<std::pair<size_type, double>> weights;
+			std::string line;
+			int lineno = 0;
+
+			while (std::getline(in, line))
+			{
+				++lineno;
+				std::istringstream s(line);
+				std::string first;
+
+				if (!(s >> first) || first[0] == '#')
+				{
+					continue;
+				}
+
+				char* end;
+				auto size = std::strtoull(first.c_str(), &end, 10);
+				double weight = 1;
+
+				if (*end != '\0' || (!(s >> weight) && !s.eof()))
+				{
+					throw circular_queue_error(path + ":" + std::to_string(lineno) + ": bad size line");
+				}
+
+				weights.emplace_back(static_cast<size_type>(size), weight);
+			}
+
+			return empirical(weights);
+		}
+
+
+		template<typename R>
+		size_type operator()(R& rng) const
+		{
+			if (_sizes.empty())
+			{
+				return _lo == _hi ? _lo : _lo + rng() % (_hi - _lo + 1);
+			}
+
+			auto u = std::uniform_real_distribution<double>(0, _cumulative.back())(rng);
+			auto i = std::upper_bound(_cumulative.begin(), _cumulative.end(), u) - _cumulative.begin();
+			return _sizes[std::min<size_type>(i, _sizes.size() - 1)];
+		}
+
+
+		size_type max() const
+		{
+			return _sizes.empty() ? _hi : *std::max_element(_sizes.begin(), _sizes.end());
+		}
+
+
+		double mean() const
+		{
+			if (_sizes.empty())
+			{
+				return (_lo + _hi) / 2.0;
+			}
+
+			double sum = 0;
+
+			for (size_type i = 0; i < _sizes.size(); ++i)
+			{
+				auto w = _cumulative[i] - (i == 0 ? 0 : _cumulative[i - 1]);
+				sum += w * _sizes[i];
+			}
+
+			return sum / _cumulative.back();
+		}
+
+
+	private:
+
+		size_distribution() :
+			_lo(0),
+			_hi(0)
+		{
+		}
+
+
+		size_type _lo;
+		size_type _hi;
+		std::vector<size_type> _sizes;
+		std::vector<double> _cumulative;
+
+	};
+
+
+	struct load_options
+	{
+		load_options() :
+			sizes(size_distribution::fixed(sizeof (load_record))),
+			records_per_second(0),
+			burst_records(1),
+			on_ns(0),
+			off_ns(0),
+			records(0),
+			duration_ns(0),
+			drop_when_full(false),
+			tag(0),
+			seed(1),
+			sent(nullptr)
+		{
+		}
+
+		// Payload sizes. Sizes below sizeof (load_record) are rounded up.
+		size_distribution sizes;
+
+		// Average rate while on. 0 sends as fast as the queue allows.
+		double records_per_second;
+
+		// Records sent back to back at each scheduled instant.
+		std::size_t burst_records;
+
+		// Alternating send and idle periods. on_ns 0 never idles.
+		std::uint64_t on_ns;
+		std::uint64_t off_ns;
+
+		// Stop after this many records, sent or dropped, or after this
+		// long, whichever comes first. 0 means no limit.
+		std::uint64_t records;
+		std::uint64_t duration_ns;
+
+		// Whether a record meeting a full queue is dropped or waits.
+		bool drop_when_full;
+
+		std::uint16_t tag;
+		std::uint64_t seed;
+
+		// Called after each record is committed, e.g. to notify a
+		// sleeping consumer.
+		std::function<void()> sent;
+	};
+
+
+	struct load_report
+	{
+		std::uint64_t records;
+		std::uint64_t bytes;
+
+		// Records that met a full queue. Records given up, either at a
+		// full queue or because they were still scheduled at the deadline.
+		std::uint64_t full_events;
+		std::uint64_t dropped;
+
+		std::uint64_t elapsed_ns;
+
+		// Largest delay of a send behind its scheduled instant.
+		std::uint64_t max_lag_ns;
+
+		double records_per_second() const
+		{
+			return elapsed_ns ? records * 1e9 / elapsed_ns : 0;
+		}
+
+
+		double bytes_per_second() const
+		{
+			return elapsed_ns ? bytes * 1e9 / elapsed_ns : 0;
+		}
+	};
+
+
+	// Drives a framed_queue<Q> with generated records. Sends on an
+	// open-loop schedule: records delayed by a full queue do not delay
+	// the ones after them.
+	template<typename Q>
+	class load_generator
+	{
+	public:
+
+		typedef std::size_t size_type;
+
+
+		load_generator(framed_queue<Q>& fq, const load_options& options) :
+			_fq(fq),
+			_options(options),
+			_rng(options.seed),
+			_end(0)
+		{
+			if (options.burst_records == 0)
+			{
+				throw circular_queue_error("Zero records per burst");
+			}
+
+			if (options.on_ns > 0 && options.off_ns == 0)
+			{
+				throw circular_queue_error("On period without off period");
+			}
+
+			auto largest = framed_queue<Q>::footprint(std::max(options.sizes.max(), sizeof (load_record)));
+
+			if (largest >= fq.queue().capacity())
+			{
+				throw circular_queue_error("Largest record does not fit in the queue");
+			}
+		}
+
+
+		load_report run()
+		{
+			std::atomic<bool> stop(false);
+			return run(stop);
+		}
+
+
+		// Runs until the record or duration limit, or until stop is set.
+		load_report run(const std::atomic<bool>& stop)
+		{
+			load_report r;
+			std::memset(&r, 0, sizeof r);
+			auto& o = _options;
+			auto interval = o.records_per_second > 0 ? o.burst_records * 1e9 / o.records_per_second : 0;
+			auto start = clock_ns();
+			_end = o.duration_ns > 0 ? start + o.duration_ns : ~std::uint64_t(0);
+			auto on_end = o.on_ns > 0 ? start + o.on_ns : ~std::uint64_t(0);
+			double next = start;
+			std::uint64_t sequence = 0;
+			bool overdue = false;
+
+			while (!stop.load(std::memory_order_relaxed))
+			{
+				auto at = static_cast<std::uint64_t>(next);
+
+				if (at >= on_end)
+				{
+					// Idle, then resume the schedule at the next on period.
+					at = on_end + o.off_ns;
+					next = at;
+					on_end = at + o.on_ns;
+				}
+
+				if (at >= _end)
+				{
+					break;
+				}
+
+				auto now = overdue ? at : wait_until(at, stop);
+
+				if (!overdue && now >= _end)
+				{
+					if (interval == 0)
+					{
+						break;
+					}
+
+					// Behind schedule at the deadline. The instants still
+					// due before it are counted as dropped.
+					overdue = true;
+				}
+
+				if (interval == 0)
+				{
+					at = now;
+				}
+
+				if (!overdue)
+				{
+					r.max_lag_ns = std::max(r.max_lag_ns, now - std::min(now, at));
+				}
+
+				for (size_type i = 0; i < o.burst_records && !done(r, stop); ++i)
+				{
+					if (overdue)
+					{
+						++sequence;
+						++r.dropped;
+					}
+					else
+					{
+						send(r, sequence++, at, stop);
+					}
+				}
+
+				if (done(r, stop))
+				{
+					break;
+				}
+
+				next += interval;
+			}
+
+			_fq.publish();
+			r.elapsed_ns = clock_ns() - start;
+			return r;
+		}
+
+
+	private:
+
+		bool done(const load_report& r, const std::atomic<bool>& stop) const
+		{
+			auto n = r.records + r.dropped;
+			return (_options.records > 0 && n >= _options.records) ||
+				stop.load(std::memory_order_relaxed);
+		}
+
+
+		// Spins, yielding while far from t so that a consumer sharing the
+		// CPU can run.
+		static std::uint64_t wait_until(std::uint64_t t, const std::atomic<bool>& stop)
+		{
+			auto now = clock_ns();
+
+			while (now < t && !stop.load(std::memory_order_relaxed))
+			{
+				if (t - now > 20000)
+				{
+					std::this_thread::yield();
+				}
+
+				now = clock_ns();
+			}
+
+			return now;
+		}
+
+
+		void send(load_report& r, std::uint64_t sequence, std::uint64_t intended, const std::atomic<bool>& stop)
+		{
+			auto size = std::max(_options.sizes(_rng), sizeof (load_record));
+			auto p = _fq.alloc(size);
+
+			if (p == nullptr)
+			{
+				++r.full_events;
+
+				do
+				{
+					if (_options.drop_when_full ||
+						stop.load(std::memory_order_relaxed) ||
+						clock_ns() >= _end)
+					{
+						++r.dropped;
+						return;
+					}
+
+					std::this_thread::yield();
+				}
+				while ((p = _fq.alloc(size)) == nullptr);
+			}
+
+			load_record lr;
+			lr.sequence = sequence;
+			lr.intended_ns = intended;
+			std::memcpy(p, &lr, sizeof lr);
+			std::memset(static_cast<char*>(p) + sizeof lr, static_cast<int>(sequence), size - sizeof lr);
+			_fq.commit(size, _options.tag);
+
+			if (_options.sent)
+			{
+				_options.sent();
+			}
+
+			++r.records;
+			r.bytes += size;
+		}
+
+
+		framed_queue<Q>& _fq;
+		load_options _options;
+		std::mt19937_64 _rng;
+		std::uint64_t _end;
+
+	};
+
+}
+
+
+#endif
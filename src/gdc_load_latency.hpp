@@ -0,0 +1,103 @@
+//
+// Copyright (c) 2016 Dado Colussi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+#ifndef __gdc__load_latency__
+#define __gdc__load_latency__
+
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include "gdc_clock.hpp"
+#include "gdc_framed_queue.hpp"
+#include "gdc_load_generator.hpp"
+
+
+// Consumer side of the load generator for benchmarks: latency of each
+// received record from its scheduled send time, and percentiles.
+
+
+namespace gdc
+{
+
+	// Nanoseconds from the instant the record at h was scheduled until
+	// now.
+	template<typename Q>
+	std::uint64_t load_latency(const record_header* h)
+	{
+		auto now = clock_ns();
+		auto r = framed_queue<Q>::template payload<load_record>(h);
+		return now - std::min(now, r->intended_ns);
+	}
+
+
+	// Pops generated records from q, spinning while it is empty, and
+	// appends their latencies until done is set and q is empty.
+	template<typename Q>
+	void drain_load(Q& q, const std::atomic<bool>& done, std::vector<std::uint64_t>& latencies)
+	{
+		framed_queue<Q> fq(q);
+
+		for (;;)
+		{
+			auto h = fq.peek();
+
+			if (h == nullptr)
+			{
+				if (done.load(std::memory_order_acquire) && fq.empty())
+				{
+					return;
+				}
+
+				std::this_thread::yield();
+				continue;
+			}
+
+			latencies.push_back(load_latency<Q>(h));
+			fq.pop();
+		}
+	}
+
+
+	// The p quantile of v, p in [0,1], or 0 if v is empty. Reorders v.
+	inline std::uint64_t latency_percentile(std::vector<std::uint64_t>& v, double p)
+	{
+		if (v.empty())
+		{
+			return 0;
+		}
+
+		auto i = static_cast<std::size_t>(p * (v.size() - 1));
+		std::nth_element(v.begin(), v.begin() + i, v.end());
+		return v[i];
+	}
+
+}
+
+
+#endif
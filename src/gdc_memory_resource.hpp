@@ -0,0 +1,150 @@
+//
+// Copyright (c) 2016 Dado Colussi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+
+#ifndef __gdc__memory_resource__
+#define __gdc__memory_resource__
+
+
+#include <cstddef>
+
+
+namespace gdc
+{
+
+	// Same shape as C++17 std::pmr::memory_resource, for C++11 code.
+	class memory_resource
+	{
+	public:
+
+		typedef std::size_t size_type;
+
+
+		virtual ~memory_resource() = default;
+
+
+		void* allocate(size_type bytes, size_type alignment = alignof(std::max_align_t))
+		{
+			return do_allocate(bytes, alignment);
+		}
+
+
+		void deallocate(void* p, size_type bytes, size_type alignment = alignof(std::max_align_t))
+		{
+			do_deallocate(p, bytes, alignment);
+		}
+
+
+		bool is_equal(const memory_resource& other) const noexcept
+		{
+			return do_is_equal(other);
+		}
+
+
+	private:
+
+		virtual void* do_allocate(size_type bytes, size_type alignment) = 0;
+		virtual void do_deallocate(void* p, size_type bytes, size_type alignment) = 0;
+		virtual bool do_is_equal(const memory_resource& other) const noexcept = 0;
+
+	};
+
+
+	inline bool operator==(const memory_resource& a, const memory_resource& b) noexcept
+	{
+		return &a == &b || a.is_equal(b);
+	}
+
+
+	inline bool operator!=(const memory_resource& a, const memory_resource& b) noexcept
+	{
+		return !(a == b);
+	}
+
+
+	// Standard allocator drawing from a memory_resource, like
+	// std::pmr::polymorphic_allocator.
+	template<typename T>
+	class resource_allocator
+	{
+	public:
+
+		typedef T value_type;
+
+
+		explicit resource_allocator(memory_resource* r) noexcept :
+			_r(r)
+		{
+		}
+
+
+		template<typename U>
+		resource_allocator(const resource_allocator<U>& other) noexcept :
+			_r(other.resource())
+		{
+		}
+
+
+		T* allocate(std::size_t n)
+		{
+			return static_cast<T*>(_r->allocate(n * sizeof (T), alignof(T)));
+		}
+
+
+		void deallocate(T* p, std::size_t n)
+		{
+			_r->deallocate(p, n * sizeof (T), alignof(T));
+		}
+
+
+		memory_resource* resource() const noexcept
+		{
+			return _r;
+		}
+
+
+	private:
+
+		memory_resource* _r;
+
+	};
+
+
+	template<typename T, typename U>
+	bool operator==(const resource_allocator<T>& a, const resource_allocator<U>& b) noexcept
+	{
+		return *a.resource() == *b.resource();
+	}
+
+
+	template<typename T, typename U>
+	bool operator!=(const resource_allocator<T>& a, const resource_allocator<U>& b) noexcept
+	{
+		return !(a == b);
+	}
+
+}
+
+
+#endif
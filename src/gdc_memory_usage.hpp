@@ -0,0 +1,460 @@
+//
+// Copyright (c) 2016 Dado Colussi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+
+#ifndef __gdc__memory_usage__
+#define __gdc__memory_usage__
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+
+#include <fstream>
+#include <sstream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "gdc_circular_queue_error.hpp"
+
+
+// What queues cost in memory. A queue mapping is the control block and
+// metadata pages, the data pages, and a second view of the data pages
+// right after them, as laid out by the factories.
+
+
+namespace gdc
+{
+
+	// Where a queue is mapped. shm_name is empty for private queues.
+	struct queue_region
+	{
+		const void* base;
+		std::size_t data_offset;
+		std::size_t capacity;
+		std::string shm_name;
+	};
+
+
+	template<typename Q>
+	queue_region make_queue_region(const Q& q, const std::string& shm_name = std::string())
+	{
+		queue_region r;
+		r.base = &q;
+		r.data_offset = q.data() - reinterpret_cast<const char*>(&q);
+		r.capacity = q.capacity();
+		r.shm_name = shm_name;
+		return r;
+	}
+
+
+	// Region of the queue held by a circular_queue_factory, creating it
+	// if needed.
+	template<typename F>
+	queue_region factory_region(F& factory)
+	{
+		return make_queue_region(factory.get(), factory.name());
+	}
+
+
+	// All sizes in bytes.
+	struct queue_memory_usage
+	{
+		queue_memory_usage() :
+			queues(0),
+			mapped(0),
+			control(0),
+			data(0),
+			control_resident(0),
+			data_resident(0),
+			huge_pages(0),
+			shm_allocated(0)
+		{
+		}
+
+
+		queue_memory_usage& operator+=(const queue_memory_usage& u)
+		{
+			queues += u.queues;
+			mapped += u.mapped;
+			control += u.control;
+			data += u.data;
+			control_resident += u.control_resident;
+			data_resident += u.data_resident;
+			huge_pages += u.huge_pages;
+			shm_allocated += u.shm_allocated;
+			return *this;
+		}
+
+
+		std::size_t resident() const
+		{
+			return control_resident + data_resident;
+		}
+
+
+		std::size_t queues;
+
+		// Address space, counting both views of the data.
+		std::size_t mapped;
+
+		// Control block and metadata pages, and data pages.
+		std::size_t control;
+		std::size_t data;
+
+		// Of the above, pages in RAM as reported by mincore(2).
+		std::size_t control_resident;
+		std::size_t data_resident;
+
+		// Mapped with transparent or hugetlb huge pages.
+		std::size_t huge_pages;
+
+		// tmpfs blocks of the shared memory object, whether resident or
+		// swapped out. 0 if the object cannot be found.
+		std::size_t shm_allocated;
+	};
+
+
+	namespace detail
+	{
+
+		inline std::size_t page_size()
+		{
+			static const long size = ::sysconf(_SC_PAGESIZE);
+			return static_cast<std::size_t>(size);
+		}
+
+
+		inline std::size_t resident_bytes(const void* addr, std::size_t len)
+		{
+			auto ps = page_size();
+			std::vector<unsigned char> pages((len + ps - 1) / ps);
+
+			if (::mincore(const_cast<void*>(addr), len, pages.data()) != 0)
+			{
+				std::string what("mincore: ");
+				what.append(::strerror(errno));
+				throw circular_queue_error(what);
+			}
+
+			std::size_t n = 0;
+
+			for (auto p : pages)
+			{
+				n += p & 1;
+			}
+
+			return n * ps;
+		}
+
+
+		struct smaps_entry
+		{
+			std::uintptr_t start;
+			std::uintptr_t end;
+			std::size_t huge_pages;
+		};
+
+
+		// Huge page bytes of every mapping of the process.
+		inline std::vector<smaps_entry> read_smaps()
+		{
+			std::vector<smaps_entry> entries;
+			std::ifstream in("/proc/self/smaps");
+			std::string line;
+
+			while (std::getline(in, line))
+			{
+				unsigned long start;
+				unsigned long end;
+				char dash;
+				std::istringstream s(line);
+
+				if (line.find(':') > line.find(' ') && s >> std::hex >> start >> dash >> end && dash == '-')
+				{
+					smaps_entry e;
+					e.start = start;
+					e.end = end;
+					e.huge_pages = 0;
+					entries.push_back(e);
+					continue;
+				}
+
+				static const char* const fields[] =
+				{
+					"AnonHugePages:",
+					"ShmemPmdMapped:",
+					"FilePmdMapped:",
+					"Shared_Hugetlb:",
+					"Private_Hugetlb:"
+				};
+
+				for (auto f : fields)
+				{
+					if (!entries.empty() && line.compare(0, std::strlen(f), f) == 0)
+					{
+						entries.back().huge_pages += std::strtoull(line.c_str() + std::strlen(f), nullptr, 10) * 1024;
+					}
+				}
+			}
+
+			return entries;
+		}
+
+
+		inline std::size_t shm_allocated(const queue_region& r, std::size_t footprint)
+		{
+			// The primary view is a mapping of its own, found under
+			// map_files even after the object is unlinked.
+			char path[64];
+			auto start = reinterpret_cast<std::uintptr_t>(r.base);
+			std::snprintf(
+				path,
+				sizeof path,
+				"/proc/self/map_files/%lx-%lx",
+				static_cast<unsigned long>(start),
+				static_cast<unsigned long>(start + footprint));
+			struct stat st;
+
+			if (::stat(path, &st) == 0)
+			{
+				return st.st_blocks * 512;
+			}
+
+			if (r.shm_name.empty())
+			{
+				return 0;
+			}
+
+			int fd = ::shm_open(r.shm_name.c_str(), O_RDONLY, 0);
+
+			if (fd == -1)
+			{
+				return 0;
+			}
+
+			auto status = ::fstat(fd, &st);
+			::close(fd);
+			return status == 0 ? st.st_blocks * 512 : 0;
+		}
+
+
+		inline queue_memory_usage memory_usage(const queue_region& r, const std::vector<smaps_entry>& smaps)
+		{
+			auto ps = page_size();
+			auto base = reinterpret_cast<const char*>(r.base);
+			queue_memory_usage u;
+			u.queues = 1;
+			u.control = r.data_offset;
+			u.data = (r.capacity + ps - 1) / ps * ps;
+			u.mapped = u.control + u.data + r.capacity;
+			u.control_resident = resident_bytes(base, u.control);
+			u.data_resident = resident_bytes(base + u.control, u.data);
+			u.shm_allocated = shm_allocated(r, u.control + u.data);
+
+			// The second view shares the pages of the first, so only count
+			// mappings within the first.
+			auto start = reinterpret_cast<std::uintptr_t>(base);
+			auto end = start + u.control + u.data;
+
+			for (auto& e : smaps)
+			{
+				if (e.start >= start && e.end <= end)
+				{
+					u.huge_pages += e.huge_pages;
+				}
+			}
+
+			return u;
+		}
+
+	}
+
+
+	inline queue_memory_usage memory_usage(const queue_region& r)
+	{
+		return detail::memory_usage(r, detail::read_smaps());
+	}
+
+
+	// Queues counted by process_memory_usage(), keyed by shared memory
+	// object name; in-process queues have an empty name. Factories don't
+	// register themselves: track() a factory to include its queue for as
+	// long as the returned registration lives, which must not be longer
+	// than the factory holds the queue.
+	class queue_registry
+	{
+	public:
+
+		class registration
+		{
+		public:
+
+			registration(registration&& r) :
+				_name(std::move(r._name)),
+				_base(r._base)
+			{
+				r._base = nullptr;
+			}
+
+
+			~registration()
+			{
+				if (_base != nullptr)
+				{
+					instance().remove(_name, _base);
+				}
+			}
+
+
+			registration(const registration&) = delete;
+			registration& operator=(const registration&) = delete;
+			registration& operator=(registration&&) = delete;
+
+
+		private:
+
+			friend class queue_registry;
+
+
+			registration(const std::string& name, const void* base) :
+				_name(name),
+				_base(base)
+			{
+			}
+
+
+			std::string _name;
+			const void* _base;
+
+		};
+
+
+		// Never destroyed, so that registrations held by static objects
+		// can be released after main() returns.
+		static queue_registry& instance()
+		{
+			static queue_registry* registry = new queue_registry();
+			return *registry;
+		}
+
+
+		template<typename F>
+		static registration track(F& factory)
+		{
+			auto r = factory_region(factory);
+			instance().add(r);
+			return registration(r.shm_name, r.base);
+		}
+
+
+		void add(const queue_region& r)
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_regions.insert(std::make_pair(r.shm_name, r));
+		}
+
+
+		void remove(const std::string& name, const void* base)
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			auto range = _regions.equal_range(name);
+
+			for (auto i = range.first; i != range.second; ++i)
+			{
+				if (i->second.base == base)
+				{
+					_regions.erase(i);
+					return;
+				}
+			}
+		}
+
+
+		// Ordered by name, so mappings of one object are adjacent.
+		std::vector<queue_region> regions() const
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			std::vector<queue_region> v;
+
+			for (auto& e : _regions)
+			{
+				v.push_back(e.second);
+			}
+
+			return v;
+		}
+
+
+	private:
+
+		queue_registry() = default;
+
+
+		mutable std::mutex _mutex;
+		std::multimap<std::string, queue_region> _regions;
+
+	};
+
+
+	// Sum over all tracked queues. A shared memory object mapped more
+	// than once counts once in shm_allocated.
+	inline queue_memory_usage process_memory_usage()
+	{
+		auto smaps = detail::read_smaps();
+		queue_memory_usage total;
+		const std::string* last = nullptr;
+
+		auto regions = queue_registry::instance().regions();
+
+		for (auto& r : regions)
+		{
+			auto u = detail::memory_usage(r, smaps);
+
+			if (!r.shm_name.empty() && last != nullptr && *last == r.shm_name)
+			{
+				u.shm_allocated = 0;
+			}
+
+			last = &r.shm_name;
+			total += u;
+		}
+
+		return total;
+	}
+
+}
+
+
+#endif
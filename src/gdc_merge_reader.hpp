@@ -0,0 +1,203 @@
+//
+// Copyright (c) 2016 Dado Colussi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+#ifndef __gdc__merge_reader__
+#define __gdc__merge_reader__
+
+
+#include <functional>
+#include <algorithm>
+#include <utility>
+#include <vector>
+#include <limits>
+#include <cstdint>
+#include <cstddef>
+#include <cassert>
+
+#include "gdc_framed_queue.hpp"
+#include "gdc_clock.hpp"
+
+
+// Merges several framed queues, each ordered by timestamp, into a single
+// stream ordered by timestamp. Records are returned in place in their
+// source queue.
+//
+// A record can only be returned once no input can still produce an older
+// one. An input with records bounds its future records by the timestamp of
+// its first record. An empty input is assumed to produce no records older
+// than its last returned record or clock_ns() - lateness, whichever is
+// later. Timestamps must therefore come from clock_ns() when inputs can
+// be idle.
+
+
+namespace gdc
+{
+
+	template<typename Q>
+	class merge_reader
+	{
+	public:
+
+		typedef std::size_t size_type;
+		typedef std::function<std::uint64_t(const record_header*)> key_type;
+
+
+		static std::uint64_t header_timestamp(const record_header* h) noexcept
+		{
+			return h->timestamp;
+		}
+
+
+		merge_reader(
+			const std::vector<framed_queue<Q>*>& inputs,
+			std::uint64_t lateness,
+			key_type key = header_timestamp) :
+			_lateness(lateness),
+			_key(key),
+			_current(inputs.size())
+		{
+			for (auto fq : inputs)
+			{
+				assert(fq != nullptr);
+				input i;
+				i.fq = fq;
+				i.last = 0;
+				i.queued = false;
+				_inputs.push_back(i);
+			}
+
+			_heap.reserve(inputs.size());
+		}
+
+
+		merge_reader(const merge_reader&) = delete;
+		merge_reader& operator=(const merge_reader&) = delete;
+
+
+		// Returns the oldest record, or nullptr if no record can be returned
+		// yet.
+		const record_header* peek()
+		{
+			bool idle = false;
+			std::uint64_t bound = std::numeric_limits<std::uint64_t>::max();
+
+			for (size_type i = 0; i < _inputs.size(); ++i)
+			{
+				auto& in = _inputs[i];
+
+				if (in.queued)
+				{
+					continue;
+				}
+
+				if (auto h = in.fq->peek())
+				{
+					_heap.push_back(std::make_pair(_key(h), i));
+					std::push_heap(_heap.begin(), _heap.end(), later);
+					in.queued = true;
+				}
+				else
+				{
+					idle = true;
+					bound = std::min(bound, in.last);
+				}
+			}
+
+			if (_heap.empty())
+			{
+				return nullptr;
+			}
+
+			auto& top = _heap.front();
+
+			if (idle && top.first > bound)
+			{
+				// Fall back to the lateness bound only when the last
+				// returned timestamps don't suffice.
+				auto now = clock_ns();
+				auto horizon = now > _lateness ? now - _lateness : 0;
+
+				if (top.first > std::max(bound, horizon))
+				{
+					return nullptr;
+				}
+			}
+
+			_current = top.second;
+			return _inputs[_current].fq->peek();
+		}
+
+
+		// Index of the input of the record returned by the last peek().
+		size_type source() const noexcept
+		{
+			return _current;
+		}
+
+
+		// Removes the record returned by the last peek().
+		void pop()
+		{
+			assert(!_heap.empty());
+			assert(_heap.front().second == _current);
+			std::pop_heap(_heap.begin(), _heap.end(), later);
+			auto& in = _inputs[_current];
+			in.last = _heap.back().first;
+			in.queued = false;
+			in.fq->pop();
+			_heap.pop_back();
+		}
+
+	private:
+
+		struct input
+		{
+			framed_queue<Q>* fq;
+			std::uint64_t last;
+			bool queued;
+		};
+
+
+		typedef std::pair<std::uint64_t, size_type> entry;
+
+
+		// Heap order. Ties go to the lower input index.
+		static bool later(const entry& a, const entry& b) noexcept
+		{
+			return a > b;
+		}
+
+
+		std::uint64_t _lateness;
+		key_type _key;
+		std::vector<input> _inputs;
+		std::vector<entry> _heap;
+		size_type _current;
+
+	};
+
+}
+
+
+#endif
@@ -0,0 +1,206 @@
+//
+// Copyright (c) 2016 Dado Colussi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+
+#ifndef __gdc__metadata__
+#define __gdc__metadata__
+
+
+#include <type_traits>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+#include "gdc_circular_queue_error.hpp"
+
+
+#ifndef LEVEL1_DCACHE_LINESIZE
+#define LEVEL1_DCACHE_LINESIZE 64
+#endif
+
+
+namespace gdc
+{
+
+	// Typed view of a queue's metadata region, protected by a seqlock. One
+	// writer updates the value while any number of readers, in any process
+	// mapping the queue, take consistent snapshots without locking. Size
+	// the region with typed_metadata<T>::footprint when creating the queue
+	// and call init() from the metadata initializer.
+	template<typename T>
+	class typed_metadata
+	{
+	public:
+
+		typedef std::size_t size_type;
+
+
+	private:
+
+		static const size_type words = (sizeof (T) + 7) / 8;
+
+
+		struct layout
+		{
+			union
+			{
+				// Even when the value is stable, odd while it is updated.
+				std::atomic<std::uint64_t> version;
+				char pad_version[LEVEL1_DCACHE_LINESIZE];
+			};
+
+			// The value is copied word by word with relaxed atomics so that
+			// a racing read is well defined, if possibly torn.
+			std::atomic<std::uint64_t> value[words];
+		};
+
+
+		layout* _md;
+
+
+		static void to_words(const T& value, std::uint64_t* w) noexcept
+		{
+			w[words - 1] = 0;
+			std::memcpy(w, &value, sizeof (T));
+		}
+
+
+	public:
+
+		static const size_type footprint = sizeof (layout);
+
+
+		// Throws if the queue's metadata region is too small for T.
+		template<typename Q>
+		explicit typed_metadata(Q& q) :
+			_md(reinterpret_cast<layout*>(q.metadata()))
+		{
+			static_assert(
+				std::is_trivially_copyable<T>::value,
+				"T in typed_metadata<T> must be trivially copyable");
+
+			if (q.metadata_size() < footprint)
+			{
+				throw circular_queue_error("Metadata region too small.");
+			}
+		}
+
+
+		// Sets the initial value. Not safe against concurrent readers.
+		void init(const T& value) noexcept
+		{
+			std::uint64_t w[words];
+			to_words(value, w);
+
+			for (size_type i = 0; i < words; ++i)
+			{
+				_md->value[i].store(w[i], std::memory_order_relaxed);
+			}
+
+			_md->version.store(0, std::memory_order_release);
+		}
+
+
+		// Publishes a new value. Only one writer at a time.
+		void store(const T& value) noexcept
+		{
+			std::uint64_t w[words];
+			to_words(value, w);
+			auto v = _md->version.load(std::memory_order_relaxed);
+			_md->version.store(v + 1, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+
+			for (size_type i = 0; i < words; ++i)
+			{
+				_md->value[i].store(w[i], std::memory_order_relaxed);
+			}
+
+			_md->version.store(v + 2, std::memory_order_release);
+		}
+
+
+		// Copies a consistent snapshot into value. Returns false if an
+		// update was in progress; value is then unchanged.
+		bool try_load(T& value) const noexcept
+		{
+			auto v1 = _md->version.load(std::memory_order_acquire);
+
+			if (v1 & 1)
+			{
+				return false;
+			}
+
+			std::uint64_t w[words];
+
+			for (size_type i = 0; i < words; ++i)
+			{
+				w[i] = _md->value[i].load(std::memory_order_relaxed);
+			}
+
+			std::atomic_thread_fence(std::memory_order_acquire);
+
+			if (_md->version.load(std::memory_order_relaxed) != v1)
+			{
+				return false;
+			}
+
+			std::memcpy(&value, w, sizeof (T));
+			return true;
+		}
+
+
+		// Retries until a consistent snapshot is read.
+		T load() const noexcept
+		{
+			T value;
+
+			while (!try_load(value))
+			{
+			}
+
+			return value;
+		}
+
+
+		// Number of updates published since init().
+		std::uint64_t version() const noexcept
+		{
+			return _md->version.load(std::memory_order_acquire) / 2;
+		}
+
+	};
+
+
+	template<typename T>
+	const typename typed_metadata<T>::size_type typed_metadata<T>::words;
+
+
+	template<typename T>
+	const typename typed_metadata<T>::size_type typed_metadata<T>::footprint;
+
+}
+
+
+#endif
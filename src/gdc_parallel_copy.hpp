@@ -0,0 +1,275 @@
+//
+// Copyright (c) 2016 Dado Colussi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+
+#ifndef __gdc__parallel_copy__
+#define __gdc__parallel_copy__
+
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+#include "gdc_framed_queue.hpp"
+
+
+namespace gdc
+{
+
+	// Helper threads splitting large memcpy()s between them and the
+	// caller. The caller copies chunks too, so a copy is never slower than
+	// a plain memcpy() by more than the hand-off, even if the helpers are
+	// slow to wake. One copy at a time; calls from several threads are
+	// serialized.
+	class copy_pool
+	{
+	public:
+
+		typedef std::size_t size_type;
+
+
+		// Copies shorter than twice min_chunk are not split.
+		explicit copy_pool(size_type helpers, size_type min_chunk = 256 * 1024) :
+			_min_chunk(std::max<size_type>(min_chunk, 64)),
+			_generation(0),
+			_active(0),
+			_stop(false),
+			_next(0),
+			_done(0)
+		{
+			try
+			{
+				for (size_type i = 0; i < helpers; ++i)
+				{
+					_helpers.emplace_back(&copy_pool::help, this);
+				}
+			}
+			catch (...)
+			{
+				// Joinable threads must not be destroyed.
+				shut_down();
+				throw;
+			}
+		}
+
+
+		~copy_pool()
+		{
+			shut_down();
+		}
+
+
+		copy_pool(const copy_pool&) = delete;
+		copy_pool& operator=(const copy_pool&) = delete;
+
+
+		size_type helpers() const noexcept
+		{
+			return _helpers.size();
+		}
+
+
+		// Returns once all of [dst, dst + n) is written and visible to
+		// the caller, so a following release store publishes it.
+		void copy(void* dst, const void* src, size_type n)
+		{
+			auto ways = std::min(_helpers.size() + 1, n / _min_chunk);
+
+			if (ways < 2)
+			{
+				std::memcpy(dst, src, n);
+				return;
+			}
+
+			std::unique_lock<std::mutex> serial(_serial);
+			job j;
+			j.dst = static_cast<char*>(dst);
+			j.src = static_cast<const char*>(src);
+			j.n = n;
+
+			// Cache line multiples, so that no two threads write a line.
+			j.chunk = (n / ways + 63) / 64 * 64;
+			j.chunks = (n + j.chunk - 1) / j.chunk;
+
+			{
+				// Helpers still inside the last job would take chunks of
+				// this one with stale addresses.
+				std::unique_lock<std::mutex> lock(_mutex);
+				_idle.wait(lock, [this]() { return _active == 0; });
+				_job = j;
+				_next.store(0, std::memory_order_relaxed);
+				_done.store(0, std::memory_order_relaxed);
+				++_generation;
+			}
+
+			_wake.notify_all();
+			work(j);
+
+			while (_done.load(std::memory_order_acquire) < j.chunks)
+			{
+				std::this_thread::yield();
+			}
+		}
+
+
+	private:
+
+		// Stops and joins the helpers started so far.
+		void shut_down() noexcept
+		{
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				_stop = true;
+			}
+
+			_wake.notify_all();
+
+			for (auto& t : _helpers)
+			{
+				t.join();
+			}
+		}
+
+
+		struct job
+		{
+			char* dst;
+			const char* src;
+			size_type n;
+			size_type chunk;
+			size_type chunks;
+		};
+
+
+		void work(const job& j)
+		{
+			for (;;)
+			{
+				auto i = _next.fetch_add(1, std::memory_order_relaxed);
+
+				if (i >= j.chunks)
+				{
+					return;
+				}
+
+				auto offset = i * j.chunk;
+				std::memcpy(j.dst + offset, j.src + offset, std::min(j.chunk, j.n - offset));
+				_done.fetch_add(1, std::memory_order_release);
+			}
+		}
+
+
+		void help()
+		{
+			std::uint64_t seen = 0;
+
+			for (;;)
+			{
+				job j;
+
+				{
+					std::unique_lock<std::mutex> lock(_mutex);
+					_wake.wait(lock, [&]() { return _stop || _generation != seen; });
+
+					if (_stop)
+					{
+						return;
+					}
+
+					seen = _generation;
+					j = _job;
+					++_active;
+				}
+
+				work(j);
+
+				{
+					std::lock_guard<std::mutex> lock(_mutex);
+					--_active;
+				}
+
+				_idle.notify_one();
+			}
+		}
+
+
+		size_type _min_chunk;
+		std::vector<std::thread> _helpers;
+		std::mutex _serial;
+		std::mutex _mutex;
+		std::condition_variable _wake;
+		std::condition_variable _idle;
+		job _job;
+		std::uint64_t _generation;
+		size_type _active;
+		bool _stop;
+		std::atomic<size_type> _next;
+		std::atomic<size_type> _done;
+
+	};
+
+
+	// Makes push() on a framed_queue<Q, copy_pool_hook> copy payloads of
+	// threshold bytes or more with a copy_pool, so that a multi-megabyte
+	// record doesn't stall the producer for the time of one memcpy().
+	class copy_pool_hook : public no_record_hook
+	{
+	public:
+
+		explicit copy_pool_hook(copy_pool& pool, std::size_t threshold = 1024 * 1024) noexcept :
+			_pool(&pool),
+			_threshold(threshold)
+		{
+		}
+
+
+		void copy(void* dst, const void* src, std::size_t n)
+		{
+			if (n >= _threshold)
+			{
+				_pool->copy(dst, src, n);
+			}
+			else
+			{
+				std::memcpy(dst, src, n);
+			}
+		}
+
+	private:
+
+		copy_pool* _pool;
+		std::size_t _threshold;
+
+	};
+
+}
+
+
+#endif
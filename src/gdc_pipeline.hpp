@@ -0,0 +1,390 @@
+//
+// Copyright (c) 2016 Dado Colussi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+#ifndef __gdc__pipeline__
+#define __gdc__pipeline__
+
+#include <unistd.h>
+
+#include <functional>
+#include <memory>
+#include <vector>
+#include <string>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include <cassert>
+
+#include "gdc_circular_queue_error.hpp"
+#include "gdc_framed_queue.hpp"
+#include "gdc_thread.hpp"
+#include "gdc_wait_strategy.hpp"
+
+
+// Processing graphs of stages connected by queues.
+//
+// Stages and edges are declared up front. start() creates one private
+// framed queue per edge and runs every stage in its own thread, optionally
+// pinned to a CPU. A stage thread calls the stage handler in a loop; the
+// handler returns the number of records it processed, 0 meaning that it
+// found nothing to do.
+//
+// F is the factory of the byte queues, e.g. circular_queue_factory<char>.
+
+
+namespace gdc
+{
+
+	template<typename F>
+	class pipeline
+	{
+	public:
+
+		typedef typename F::value_type queue_type;
+		typedef framed_queue<queue_type> framed_queue_type;
+		typedef typename queue_type::size_type size_type;
+
+
+		class stage
+		{
+		public:
+
+			const std::string& name() const noexcept
+			{
+				return _name;
+			}
+
+
+			size_type inputs() const noexcept
+			{
+				return _inputs.size();
+			}
+
+
+			size_type outputs() const noexcept
+			{
+				return _outputs.size();
+			}
+
+
+			// Inputs and outputs in the order they were connected.
+			framed_queue_type& input(size_type i = 0) noexcept
+			{
+				assert(i < _inputs.size());
+				return *_inputs[i];
+			}
+
+
+			framed_queue_type& output(size_type i = 0) noexcept
+			{
+				assert(i < _outputs.size());
+				return *_outputs[i];
+			}
+
+		private:
+
+			friend class pipeline;
+
+			std::string _name;
+			std::vector<framed_queue_type*> _inputs;
+			std::vector<framed_queue_type*> _outputs;
+		};
+
+
+		typedef std::function<size_type(stage&)> handler_type;
+
+
+		struct stage_stats
+		{
+			std::string name;
+			int cpu;
+			std::uint64_t busy_iterations;
+			std::uint64_t idle_iterations;
+			std::uint64_t records;
+			double records_per_second;
+		};
+
+
+		struct edge_stats
+		{
+			std::string from;
+			std::string to;
+			size_type capacity;
+			size_type occupancy;
+		};
+
+
+		// Edges connected without a capacity get default_capacity bytes.
+		explicit pipeline(size_type default_capacity = 1024 * 1024) :
+			_default_capacity(default_capacity),
+			_running(false)
+		{
+		}
+
+
+		pipeline(const pipeline&) = delete;
+		pipeline& operator=(const pipeline&) = delete;
+
+
+		~pipeline()
+		{
+			halt();
+		}
+
+
+		void add_stage(
+			const std::string& name,
+			handler_type handler,
+			int cpu = -1,
+			wait_mode wait = wait_mode::busy_poll)
+		{
+			assert(!_running);
+
+			if (find(name) != nullptr)
+			{
+				throw circular_queue_error("pipeline: duplicate stage " + name);
+			}
+
+			std::unique_ptr<stage_state> s(new stage_state());
+			s->io._name = name;
+			s->handler = handler;
+			s->cpu = cpu;
+			s->wait = wait;
+			_stages.push_back(std::move(s));
+		}
+
+
+		// Connects an output of stage from to an input of stage to. The
+		// capacity is rounded up to whole pages.
+		void connect(const std::string& from, const std::string& to, size_type capacity = 0)
+		{
+			assert(!_running);
+			auto f = find(from);
+			auto t = find(to);
+
+			if (f == nullptr || t == nullptr)
+			{
+				throw circular_queue_error("pipeline: unknown stage " + (f ? to : from));
+			}
+
+			static long page_size = ::sysconf(_SC_PAGESIZE);
+			size_type c = capacity > 0 ? capacity : _default_capacity;
+			c = (c + page_size - 1) / page_size * page_size;
+
+			std::unique_ptr<edge> e(new edge(c));
+			e->from = f;
+			e->to = t;
+			f->io._outputs.push_back(&e->queue);
+			t->io._inputs.push_back(&e->queue);
+			_edges.push_back(std::move(e));
+		}
+
+
+		void start()
+		{
+			assert(!_running);
+			_running.store(true, std::memory_order_release);
+			_start_time = std::chrono::steady_clock::now();
+
+			for (auto& s : _stages)
+			{
+				auto st = s.get();
+				s->worker.start(_running, [this, st]() { run(st); });
+			}
+		}
+
+
+		// Stops and joins all stages. Rethrows the first exception thrown
+		// by a stage.
+		void stop()
+		{
+			halt();
+
+			for (auto& s : _stages)
+			{
+				s->worker.rethrow();
+			}
+		}
+
+
+		bool running() const noexcept
+		{
+			return _running.load(std::memory_order_relaxed);
+		}
+
+
+		std::vector<stage_stats> stage_statistics() const
+		{
+			std::vector<stage_stats> v;
+			auto now = _stop_time > _start_time ? _stop_time : std::chrono::steady_clock::now();
+			std::chrono::duration<double> elapsed = now - _start_time;
+
+			for (auto& s : _stages)
+			{
+				stage_stats st;
+				st.name = s->io._name;
+				st.cpu = s->cpu;
+				st.busy_iterations = s->busy.load(std::memory_order_relaxed);
+				st.idle_iterations = s->idle.load(std::memory_order_relaxed);
+				st.records = s->records.load(std::memory_order_relaxed);
+				st.records_per_second = elapsed.count() > 0 ? st.records / elapsed.count() : 0;
+				v.push_back(st);
+			}
+
+			return v;
+		}
+
+
+		std::vector<edge_stats> edge_statistics() const
+		{
+			std::vector<edge_stats> v;
+
+			for (auto& e : _edges)
+			{
+				edge_stats st;
+				st.from = e->from->io._name;
+				st.to = e->to->io._name;
+				st.capacity = e->factory.get().capacity();
+				st.occupancy = e->factory.get().available();
+				v.push_back(st);
+			}
+
+			return v;
+		}
+
+	private:
+
+		struct stage_state
+		{
+			stage_state() :
+				cpu(-1),
+				wait(wait_mode::busy_poll),
+				busy(0),
+				idle(0),
+				records(0)
+			{
+			}
+
+			pipeline::stage io;
+			handler_type handler;
+			int cpu;
+			wait_mode wait;
+			worker_thread worker;
+
+			// Written by the stage thread only.
+			std::atomic<std::uint64_t> busy;
+			std::atomic<std::uint64_t> idle;
+			std::atomic<std::uint64_t> records;
+		};
+
+
+		struct edge
+		{
+			explicit edge(size_type capacity) :
+				factory(capacity),
+				queue(factory.get())
+			{
+			}
+
+			mutable F factory;
+			framed_queue_type queue;
+			stage_state* from;
+			stage_state* to;
+		};
+
+
+		void run(stage_state* s)
+		{
+			if (s->cpu >= 0)
+			{
+				pin_current_thread(s->cpu);
+			}
+
+			poll_while(_running, s->wait, [s]()
+			{
+				auto n = s->handler(s->io);
+
+				if (n > 0)
+				{
+					add_relaxed(s->busy, 1);
+					add_relaxed(s->records, n);
+				}
+				else
+				{
+					add_relaxed(s->idle, 1);
+				}
+
+				return n;
+			});
+		}
+
+
+		void halt() noexcept
+		{
+			_running.store(false, std::memory_order_relaxed);
+			bool joined = false;
+
+			for (auto& s : _stages)
+			{
+				if (s->worker.join())
+				{
+					joined = true;
+				}
+			}
+
+			if (joined)
+			{
+				_stop_time = std::chrono::steady_clock::now();
+			}
+		}
+
+
+		stage_state* find(const std::string& name) const noexcept
+		{
+			for (auto& s : _stages)
+			{
+				if (s->io._name == name)
+				{
+					return s.get();
+				}
+			}
+
+			return nullptr;
+		}
+
+
+		size_type _default_capacity;
+		std::vector<std::unique_ptr<stage_state>> _stages;
+		std::vector<std::unique_ptr<edge>> _edges;
+		std::atomic<bool> _running;
+		std::chrono::steady_clock::time_point _start_time;
+		std::chrono::steady_clock::time_point _stop_time;
+
+	};
+
+}
+
+
+#endif
@@ -0,0 +1,270 @@
+//
+// Copyright (c) 2016 Dado Colussi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+
+#ifndef __gdc__rate_limiter__
+#define __gdc__rate_limiter__
+
+
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+
+#include "gdc_clock.hpp"
+#include "gdc_framed_queue.hpp"
+
+
+namespace gdc
+{
+
+	// Zero rates mean unlimited. Bursts default to one second worth.
+	struct rate_limit
+	{
+		rate_limit() :
+			bytes_per_second(0),
+			records_per_second(0),
+			burst_bytes(0),
+			burst_records(0)
+		{
+		}
+
+		double bytes_per_second;
+		double records_per_second;
+		double burst_bytes;
+		double burst_records;
+	};
+
+
+	// Token buckets for bytes and records, refilled from tsc(). A record
+	// that fits the tokens left costs no clock read; time is only read to
+	// refill when a bucket runs short.
+	class rate_limiter
+	{
+	public:
+
+		typedef std::size_t size_type;
+
+
+		struct statistics
+		{
+			std::uint64_t records;
+			std::uint64_t bytes;
+			std::uint64_t throttled_calls;
+			std::uint64_t throttled_ns;
+		};
+
+
+		typedef std::uint64_t (*clock_function)();
+
+
+		// Time comes from tsc() unless clock is given, ticking
+		// ticks_per_ns times per nanosecond, e.g. a simulated clock.
+		explicit rate_limiter(
+			const rate_limit& limit,
+			clock_function clock = nullptr,
+			double ticks_per_ns = 1) :
+			_clock(clock != nullptr ? clock : &tsc),
+			_ticks_per_ns(clock != nullptr ? ticks_per_ns : tsc_per_ns()),
+			_last(0),
+			_throttled(false),
+			_throttled_since(0),
+			_throttled_ticks(0),
+			_stats()
+		{
+			auto ticks_per_second = _ticks_per_ns * 1e9;
+			setup(_bytes, limit.bytes_per_second, limit.burst_bytes, 0, ticks_per_second);
+
+			// A record costs one token, so the bucket must hold at least
+			// one even at rates below 1/s.
+			setup(_records, limit.records_per_second, limit.burst_records, 1, ticks_per_second);
+			_last = _clock();
+		}
+
+
+		// Returns true if there are tokens for one record of nbytes, but
+		// takes none. A record larger than the byte burst waits for a full
+		// bucket.
+		bool admit(size_type nbytes) noexcept
+		{
+			auto need = std::min(static_cast<double>(nbytes), _bytes.burst);
+
+			if (_bytes.tokens < need || _records.tokens < 1)
+			{
+				auto now = _clock();
+				refill(now);
+
+				if (_bytes.tokens < need || _records.tokens < 1)
+				{
+					if (!_throttled)
+					{
+						_throttled = true;
+						_throttled_since = now;
+					}
+
+					++_stats.throttled_calls;
+					return false;
+				}
+
+				if (_throttled)
+				{
+					_throttled_ticks += now - _throttled_since;
+					_throttled = false;
+				}
+			}
+
+			return true;
+		}
+
+
+		// Takes tokens for one record of nbytes, after admit() for at
+		// least nbytes.
+		void consume(size_type nbytes) noexcept
+		{
+			_bytes.tokens -= std::min(static_cast<double>(nbytes), _bytes.burst);
+			_records.tokens -= 1;
+			++_stats.records;
+			_stats.bytes += nbytes;
+		}
+
+
+		// Takes tokens for one record of nbytes. Returns false, taking
+		// nothing, if the record must wait.
+		bool try_acquire(size_type nbytes) noexcept
+		{
+			if (!admit(nbytes))
+			{
+				return false;
+			}
+
+			consume(nbytes);
+			return true;
+		}
+
+
+		// Throttled time includes the current wait, if any.
+		statistics stats() const
+		{
+			auto st = _stats;
+			auto ticks = _throttled_ticks;
+
+			if (_throttled)
+			{
+				ticks += _clock() - _throttled_since;
+			}
+
+			st.throttled_ns = static_cast<std::uint64_t>(ticks / _ticks_per_ns);
+			return st;
+		}
+
+
+	private:
+
+		struct bucket
+		{
+			double tokens;
+			double burst;
+			double per_tick;
+		};
+
+
+		static void setup(
+			bucket& b,
+			double per_second,
+			double burst,
+			double min_burst,
+			double ticks_per_second)
+		{
+			if (per_second <= 0)
+			{
+				// Unlimited.
+				b.burst = 1e300;
+				b.per_tick = 0;
+			}
+			else
+			{
+				b.burst = std::max(burst > 0 ? burst : per_second, min_burst);
+				b.per_tick = per_second / ticks_per_second;
+			}
+
+			b.tokens = b.burst;
+		}
+
+
+		void refill(std::uint64_t now) noexcept
+		{
+			auto elapsed = static_cast<double>(now - _last);
+			_last = now;
+			_bytes.tokens = std::min(_bytes.burst, _bytes.tokens + elapsed * _bytes.per_tick);
+			_records.tokens = std::min(_records.burst, _records.tokens + elapsed * _records.per_tick);
+		}
+
+
+		clock_function _clock;
+		double _ticks_per_ns;
+		bucket _bytes;
+		bucket _records;
+		std::uint64_t _last;
+		bool _throttled;
+		std::uint64_t _throttled_since;
+		std::uint64_t _throttled_ticks;
+		statistics _stats;
+
+	};
+
+
+	// Caps the producer of a framed_queue<Q, rate_limit_hook>: alloc()
+	// returns nullptr, as for a full queue, while the limiter refuses the
+	// record. Tokens are taken at commit, so a shorter or abandoned
+	// record costs only what is published.
+	class rate_limit_hook : public no_record_hook
+	{
+	public:
+
+		explicit rate_limit_hook(rate_limiter& limiter) noexcept :
+			_limiter(&limiter)
+		{
+		}
+
+
+		bool admit(std::size_t footprint) noexcept
+		{
+			return _limiter->admit(footprint);
+		}
+
+
+		void commit(record_header& h, std::size_t) noexcept
+		{
+			_limiter->consume(record_footprint(h.size));
+		}
+
+	private:
+
+		rate_limiter* _limiter;
+
+	};
+
+}
+
+
+#endif
@@ -0,0 +1,161 @@
+//
+// Copyright (c) 2016 Dado Colussi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+#ifndef __gdc__sequencer__
+#define __gdc__sequencer__
+
+
+#include <atomic>
+#include <new>
+#include <cstdint>
+#include <cassert>
+
+#include "gdc_circular_queue_error.hpp"
+#include "gdc_framed_queue.hpp"
+
+
+#ifndef LEVEL1_DCACHE_LINESIZE
+#define LEVEL1_DCACHE_LINESIZE 64
+#endif
+
+#ifndef GDC_CONTROL_BLOCK_PADDING
+#define GDC_CONTROL_BLOCK_PADDING LEVEL1_DCACHE_LINESIZE
+#endif
+
+
+namespace gdc
+{
+
+	// Global sequence counter shared by producers. It is trivially
+	// copyable so that it can live in shared memory, e.g. in queue
+	// metadata. Call init() once before use.
+	struct alignas(LEVEL1_DCACHE_LINESIZE) sequencer
+	{
+		union
+		{
+			// Next unallocated sequence number. Sequence numbers start at
+			// 1; 0 means unsequenced.
+			std::atomic<std::uint64_t> next;
+			char pad_next[LEVEL1_DCACHE_LINESIZE];
+		};
+
+
+		void init() noexcept
+		{
+			next.store(1, std::memory_order_relaxed);
+		}
+	};
+
+
+	// Constructs and initializes a sequencer at the start of the metadata
+	// of q. The metadata follows three paddings of the control block, and
+	// the control block starts a page.
+	template<typename Q>
+	sequencer* make_metadata_sequencer(Q& q)
+	{
+		static_assert(
+			3 * GDC_CONTROL_BLOCK_PADDING % alignof (sequencer) == 0,
+			"queue metadata is not cache line aligned");
+
+		if (q.metadata_size() < sizeof (sequencer))
+		{
+			throw circular_queue_error("Metadata region too small.");
+		}
+
+		auto s = new (q.metadata()) sequencer();
+		s->init();
+		return s;
+	}
+
+
+	// Per producer view of a sequencer. With a batch size above 1 it takes
+	// ranges of sequence numbers from the sequencer, trading strict commit
+	// order between producers for less contention on the shared counter.
+	// Numbers are always unique and increase within each producer.
+	class sequence_source
+	{
+	public:
+
+		explicit sequence_source(sequencer& s, std::uint64_t batch = 1) noexcept :
+			_s(s),
+			_batch(batch),
+			_next(0),
+			_end(0)
+		{
+			assert(batch > 0);
+		}
+
+
+		sequence_source(const sequence_source&) = delete;
+		sequence_source& operator=(const sequence_source&) = delete;
+
+
+		std::uint64_t next() noexcept
+		{
+			if (_next == _end)
+			{
+				_next = _s.next.fetch_add(_batch, std::memory_order_relaxed);
+				_end = _next + _batch;
+			}
+
+			return _next++;
+		}
+
+	private:
+
+		sequencer& _s;
+		std::uint64_t _batch;
+		std::uint64_t _next;
+		std::uint64_t _end;
+
+	};
+
+
+	// Numbers the records of a framed_queue<Q, sequence_hook> from a
+	// sequence_source at commit.
+	class sequence_hook : public no_record_hook
+	{
+	public:
+
+		explicit sequence_hook(sequence_source& s) noexcept :
+			_s(&s)
+		{
+		}
+
+
+		void commit(record_header& h, std::size_t) noexcept
+		{
+			h.sequence = _s->next();
+		}
+
+	private:
+
+		sequence_source* _s;
+
+	};
+
+}
+
+
+#endif
@@ -0,0 +1,211 @@
+//
+// Copyright (c) 2016 Dado Colussi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+#ifndef __gdc__thread__
+#define __gdc__thread__
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <errno.h>
+
+#include <atomic>
+#include <exception>
+#include <thread>
+#include <string>
+#include <cstdint>
+#include <cstring>
+
+#include "gdc_circular_queue_error.hpp"
+
+
+namespace gdc
+{
+
+	// What a polling thread does when an iteration found nothing to do.
+	enum class wait_mode
+	{
+		// Call the handler again right away.
+		busy_poll,
+
+		// Sleep after idle iterations, backing off up to 1 ms.
+		park
+	};
+
+
+	// Adds n to a counter that only the calling thread writes, without a
+	// locked instruction. Other threads may read it at any time.
+	inline void add_relaxed(std::atomic<std::uint64_t>& counter, std::uint64_t n) noexcept
+	{
+		counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+	}
+
+
+	// A thread whose exception, if it throws one, is kept for its owner
+	// to rethrow after join(). The exception also clears running, so that
+	// other threads polling the flag stop too.
+	class worker_thread
+	{
+	public:
+
+		template<typename Function>
+		void start(std::atomic<bool>& running, Function f)
+		{
+			_error = nullptr;
+			_thread = std::thread([this, &running, f]()
+			{
+				try
+				{
+					f();
+				}
+				catch (...)
+				{
+					_error = std::current_exception();
+					running.store(false, std::memory_order_relaxed);
+				}
+			});
+		}
+
+
+		bool joinable() const noexcept
+		{
+			return _thread.joinable();
+		}
+
+
+		// Returns false if there was no thread to join.
+		bool join() noexcept
+		{
+			if (!_thread.joinable())
+			{
+				return false;
+			}
+
+			_thread.join();
+			return true;
+		}
+
+
+		// Rethrows, once, the exception the thread stopped with.
+		void rethrow()
+		{
+			if (_error)
+			{
+				auto error = _error;
+				_error = nullptr;
+				std::rethrow_exception(error);
+			}
+		}
+
+
+	private:
+
+		std::thread _thread;
+		std::exception_ptr _error;
+
+	};
+
+
+	// Binds the calling thread to one CPU.
+	inline void pin_current_thread(int cpu)
+	{
+#ifdef __linux__
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		CPU_SET(cpu, &set);
+		int status = ::pthread_setaffinity_np(::pthread_self(), sizeof set, &set);
+
+		if (status != 0)
+		{
+			std::string what("pthread_setaffinity_np: ");
+			what.append(::strerror(status));
+			throw circular_queue_error(what);
+		}
+#else
+		(void)cpu;
+		throw circular_queue_error("pin_current_thread: not supported");
+#endif
+	}
+
+
+	// Whether the calling thread is allowed to run on cpu, so that
+	// pin_current_thread(cpu) can succeed.
+	inline bool can_pin_current_thread(int cpu)
+	{
+#ifdef __linux__
+		if (cpu < 0 || cpu >= CPU_SETSIZE)
+		{
+			return false;
+		}
+
+		cpu_set_t set;
+		CPU_ZERO(&set);
+
+		if (::pthread_getaffinity_np(::pthread_self(), sizeof set, &set) != 0)
+		{
+			return false;
+		}
+
+		return CPU_ISSET(cpu, &set);
+#else
+		(void)cpu;
+		return false;
+#endif
+	}
+
+
+	// Switches the calling thread to SCHED_FIFO with the given priority.
+	// Usually needs CAP_SYS_NICE.
+	inline void set_current_thread_fifo_priority(int priority)
+	{
+		sched_param param;
+		std::memset(&param, 0, sizeof param);
+		param.sched_priority = priority;
+		int status = ::pthread_setschedparam(::pthread_self(), SCHED_FIFO, &param);
+
+		if (status != 0)
+		{
+			std::string what("pthread_setschedparam: ");
+			what.append(::strerror(status));
+			throw circular_queue_error(what);
+		}
+	}
+
+
+	// Locks current and future pages of the process in memory so that
+	// the hot path never takes a major page fault.
+	inline void lock_process_memory()
+	{
+		if (::mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+		{
+			std::string what("mlockall: ");
+			what.append(::strerror(errno));
+			throw circular_queue_error(what);
+		}
+	}
+
+}
+
+
+#endif
@@ -0,0 +1,220 @@
+//
+// Copyright (c) 2016 Dado Colussi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+#ifndef __gdc__time_index__
+#define __gdc__time_index__
+
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <cassert>
+
+#include "gdc_framed_queue.hpp"
+
+
+#ifndef LEVEL1_DCACHE_LINESIZE
+#define LEVEL1_DCACHE_LINESIZE 64
+#endif
+
+
+namespace gdc
+{
+
+	// Sparse index from record timestamps to queue positions, written by
+	// the producer every few records and read by the consumer to skip
+	// expired records without reading them. It is trivially copyable so
+	// that it can live in shared memory next to the queue, e.g. in queue
+	// metadata. Call init() once before use.
+	struct time_index
+	{
+		static const std::size_t size = 64;
+
+
+		struct entry
+		{
+			// Odd while the entry is being written.
+			std::atomic<std::uint64_t> version;
+			std::atomic<std::uint64_t> timestamp;
+			std::atomic<std::uint64_t> position;
+		};
+
+
+		union
+		{
+			// Number of entries ever written. Entry i is in
+			// entries[i % size].
+			std::atomic<std::uint64_t> count;
+			char pad_count[LEVEL1_DCACHE_LINESIZE];
+		};
+
+		entry entries[size];
+
+
+		void init() noexcept
+		{
+			count.store(0, std::memory_order_relaxed);
+
+			for (auto& e : entries)
+			{
+				e.version.store(0, std::memory_order_relaxed);
+			}
+
+			std::atomic_thread_fence(std::memory_order_release);
+		}
+
+
+		// Producer only.
+		void add(std::uint64_t timestamp, std::uint64_t position) noexcept
+		{
+			auto c = count.load(std::memory_order_relaxed);
+			auto& e = entries[c % size];
+			auto v = e.version.load(std::memory_order_relaxed);
+			e.version.store(v + 1, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+			e.timestamp.store(timestamp, std::memory_order_relaxed);
+			e.position.store(position, std::memory_order_relaxed);
+			e.version.store(v + 2, std::memory_order_release);
+			count.store(c + 1, std::memory_order_release);
+		}
+
+
+		// Reads entry i consistently. Returns false if it is being
+		// overwritten.
+		bool get(std::uint64_t i, std::uint64_t& timestamp, std::uint64_t& position) const noexcept
+		{
+			auto& e = entries[i % size];
+			auto v = e.version.load(std::memory_order_acquire);
+			timestamp = e.timestamp.load(std::memory_order_relaxed);
+			position = e.position.load(std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_acquire);
+			return (v & 1) == 0 && e.version.load(std::memory_order_relaxed) == v;
+		}
+	};
+
+
+	// Adds an entry to a time_index every interval records committed to a
+	// framed_queue<Q, time_index_hook>. Requires stamped records.
+	class time_index_hook : public no_record_hook
+	{
+	public:
+
+		explicit time_index_hook(time_index& index, std::size_t interval = 64) noexcept :
+			_index(&index),
+			_interval(interval),
+			_countdown(0)
+		{
+			assert(interval > 0);
+		}
+
+
+		void commit(record_header& h, std::size_t offset) noexcept
+		{
+			if (_countdown-- == 0)
+			{
+				_countdown = _interval - 1;
+				_index->add(h.timestamp, offset);
+			}
+		}
+
+	private:
+
+		time_index* _index;
+		std::size_t _interval;
+		std::size_t _countdown;
+
+	};
+
+
+	// Removes all records of fq with a timestamp older than deadline.
+	// Jumps over most of them using the index its producer maintains with
+	// a time_index_hook, without reading them. Returns the number of
+	// bytes removed.
+	template<typename Q, typename H>
+	typename Q::size_type skip_older_than(
+		framed_queue<Q, H>& fq,
+		const time_index& index,
+		std::uint64_t deadline)
+	{
+		typedef typename Q::size_type size_type;
+		auto& q = fq.queue();
+		fq.release();
+		auto head = fq.peek();
+
+		if (head == nullptr || head->timestamp >= deadline)
+		{
+			return 0;
+		}
+
+		auto c = q.capacity();
+		auto avail = q.available();
+		std::atomic_thread_fence(std::memory_order_acquire);
+		auto first = reinterpret_cast<const char*>(head);
+		size_type rp = first - q.data();
+		size_type skip = 0;
+		auto n = index.count.load(std::memory_order_acquire);
+		auto oldest = n > time_index::size ? n - time_index::size : 0;
+
+		// Newest usable entry. Entries of consumed records are either
+		// out of the readable range or older than the head record.
+		for (auto i = n; i > oldest; --i)
+		{
+			std::uint64_t ts;
+			std::uint64_t pos;
+
+			if (!index.get(i - 1, ts, pos) || ts >= deadline || ts < head->timestamp)
+			{
+				continue;
+			}
+
+			size_type d = (pos + c - rp) % c;
+
+			if (d < avail)
+			{
+				skip = d;
+				break;
+			}
+		}
+
+		// Walk the few records between the entry and the deadline.
+		while (skip < avail)
+		{
+			auto h = reinterpret_cast<const record_header*>(first + skip);
+
+			if (h->timestamp >= deadline)
+			{
+				break;
+			}
+
+			skip += record_footprint(h->size);
+		}
+
+		q.pop(skip);
+		return skip;
+	}
+
+}
+
+
+#endif
@@ -0,0 +1,255 @@
+//
+// Copyright (c) 2016 Dado Colussi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+
+#ifndef __gdc__topology__
+#define __gdc__topology__
+
+
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <vector>
+#include <string>
+#include <cstdlib>
+#include <unistd.h>
+
+
+namespace gdc
+{
+
+	// How closely two CPUs share hardware, closest first.
+	enum class cpu_relation
+	{
+		same_cpu,
+		smt_sibling,
+		shared_l2,
+		shared_llc,
+		same_package,
+		same_package_other_die,
+		remote
+	};
+
+
+	inline const char* to_string(cpu_relation r) noexcept
+	{
+		switch (r)
+		{
+			case cpu_relation::same_cpu: return "same cpu";
+			case cpu_relation::smt_sibling: return "smt sibling";
+			case cpu_relation::shared_l2: return "shared L2";
+			case cpu_relation::shared_llc: return "shared LLC";
+			case cpu_relation::same_package: return "same package";
+			case cpu_relation::same_package_other_die: return "same package, other die";
+			case cpu_relation::remote: return "remote";
+		}
+
+		return "unknown";
+	}
+
+
+	struct cpu_info
+	{
+		int cpu;
+		int core;
+		int package;
+		int die;
+
+		// CPUs sharing the core, L2 and last level cache, this one included.
+		std::vector<int> smt_siblings;
+		std::vector<int> l2_sharers;
+		std::vector<int> llc_sharers;
+	};
+
+
+	namespace detail
+	{
+
+		inline std::string read_sysfs(const std::string& path)
+		{
+			std::ifstream in(path);
+			std::string s;
+			std::getline(in, s);
+			return s;
+		}
+
+
+		inline int read_sysfs_int(const std::string& path, int missing)
+		{
+			auto s = read_sysfs(path);
+			return s.empty() ? missing : std::atoi(s.c_str());
+		}
+
+
+		inline bool contains(const std::vector<int>& v, int x)
+		{
+			return std::find(v.begin(), v.end(), x) != v.end();
+		}
+
+	}
+
+
+	// Parses a kernel CPU list such as "0-3,8,10-11".
+	inline std::vector<int> parse_cpu_list(const std::string& list)
+	{
+		std::vector<int> v;
+		std::stringstream ss(list);
+		std::string range;
+
+		while (std::getline(ss, range, ','))
+		{
+			if (range.empty())
+			{
+				continue;
+			}
+
+			auto dash = range.find('-');
+			int first = std::atoi(range.c_str());
+			int last = dash == std::string::npos ? first : std::atoi(range.c_str() + dash + 1);
+
+			for (int i = first; i <= last; ++i)
+			{
+				v.push_back(i);
+			}
+		}
+
+		return v;
+	}
+
+
+	// Reads the topology of the online CPUs from sysfs. Missing entries
+	// leave the CPU as its own core, package and cache domains.
+	inline std::vector<cpu_info> read_cpu_topology(
+		const std::string& root = "/sys/devices/system/cpu")
+	{
+		std::vector<cpu_info> cpus;
+		auto online = parse_cpu_list(detail::read_sysfs(root + "/online"));
+
+		for (int cpu : online)
+		{
+			auto dir = root + "/cpu" + std::to_string(cpu);
+			cpu_info info;
+			info.cpu = cpu;
+			info.core = detail::read_sysfs_int(dir + "/topology/core_id", cpu);
+			info.package = detail::read_sysfs_int(dir + "/topology/physical_package_id", 0);
+			info.die = detail::read_sysfs_int(dir + "/topology/die_id", 0);
+			info.smt_siblings = parse_cpu_list(detail::read_sysfs(dir + "/topology/thread_siblings_list"));
+			int llc_level = 0;
+
+			for (int i = 0; ; ++i)
+			{
+				auto cache = dir + "/cache/index" + std::to_string(i);
+				auto level = detail::read_sysfs_int(cache + "/level", -1);
+
+				if (level == -1)
+				{
+					break;
+				}
+
+				if (detail::read_sysfs(cache + "/type") == "Instruction")
+				{
+					continue;
+				}
+
+				auto sharers = parse_cpu_list(detail::read_sysfs(cache + "/shared_cpu_list"));
+
+				if (level == 2)
+				{
+					info.l2_sharers = sharers;
+				}
+
+				if (level >= llc_level)
+				{
+					llc_level = level;
+					info.llc_sharers = sharers;
+				}
+			}
+
+			for (auto v : {&info.smt_siblings, &info.l2_sharers, &info.llc_sharers})
+			{
+				if (v->empty())
+				{
+					v->push_back(cpu);
+				}
+			}
+
+			cpus.push_back(info);
+		}
+
+		return cpus;
+	}
+
+
+	// Cache line size reported by the kernel, or 64 if unknown. Compare
+	// with GDC_CONTROL_BLOCK_PADDING to choose a layout profile.
+	inline long detected_cache_line_size(
+		const std::string& root = "/sys/devices/system/cpu")
+	{
+		long n = detail::read_sysfs_int(root + "/cpu0/cache/index0/coherency_line_size", 0);
+#ifdef _SC_LEVEL1_DCACHE_LINESIZE
+		if (n <= 0)
+		{
+			n = ::sysconf(_SC_LEVEL1_DCACHE_LINESIZE);
+		}
+#endif
+		return n > 0 ? n : 64;
+	}
+
+
+	inline cpu_relation relation(const cpu_info& a, const cpu_info& b) noexcept
+	{
+		if (a.cpu == b.cpu)
+		{
+			return cpu_relation::same_cpu;
+		}
+
+		if (detail::contains(a.smt_siblings, b.cpu))
+		{
+			return cpu_relation::smt_sibling;
+		}
+
+		if (detail::contains(a.l2_sharers, b.cpu))
+		{
+			return cpu_relation::shared_l2;
+		}
+
+		if (detail::contains(a.llc_sharers, b.cpu))
+		{
+			return cpu_relation::shared_llc;
+		}
+
+		if (a.package == b.package)
+		{
+			return a.die == b.die ?
+				cpu_relation::same_package :
+				cpu_relation::same_package_other_die;
+		}
+
+		return cpu_relation::remote;
+	}
+
+}
+
+
+#endif
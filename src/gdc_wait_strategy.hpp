@@ -0,0 +1,366 @@
+//
+// Copyright (c) 2016 Dado Colussi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+
+#ifndef __gdc__wait_strategy__
+#define __gdc__wait_strategy__
+
+#include <unistd.h>
+#include <errno.h>
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <sys/eventfd.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <cstdint>
+#include <cstring>
+
+#include "gdc_circular_queue_error.hpp"
+#include "gdc_thread.hpp"
+
+
+// How a consumer waits for a queue to become non-empty.
+//
+// The producer calls notify() after publishing and the consumer calls
+// wait(ready), where ready() tests the queue, e.g. !fq.empty(). Only the
+// blocking strategies make notify() do anything, and even then only a
+// fence and a load unless the consumer is asleep. A producer stopping the
+// consumer sets its stop flag, tested by ready(), then calls notify().
+
+
+namespace gdc
+{
+
+	// Polls ready() without pause. Lowest latency; burns a core.
+	class spin_wait
+	{
+	public:
+
+		void notify() noexcept
+		{
+		}
+
+
+		template<typename Ready>
+		void wait(Ready ready)
+		{
+			while (!ready())
+			{
+			}
+		}
+
+	};
+
+
+	// Polls, then yields, then sleeps with doubling intervals up to 1 ms.
+	class backoff_wait
+	{
+	public:
+
+		explicit backoff_wait(unsigned spins = 1000, unsigned yields = 10) noexcept :
+			_spins(spins),
+			_yields(yields)
+		{
+		}
+
+
+		void notify() noexcept
+		{
+		}
+
+
+		template<typename Ready>
+		void wait(Ready ready)
+		{
+			const std::chrono::microseconds max_park(1000);
+			std::chrono::microseconds park(1);
+
+			for (unsigned i = 0; !ready(); ++i)
+			{
+				if (i < _spins)
+				{
+					continue;
+				}
+
+				if (i < _spins + _yields)
+				{
+					std::this_thread::yield();
+					continue;
+				}
+
+				std::this_thread::sleep_for(park);
+				park = std::min(park * 2, max_park);
+			}
+		}
+
+
+	private:
+
+		unsigned _spins;
+		unsigned _yields;
+
+	};
+
+
+	// Calls poll() until running is cleared, waiting while poll() returns
+	// 0 as mode says: busy_poll spins, park sleeps with backoff_wait
+	// without its spin and yield phases.
+	template<typename Poll>
+	void poll_while(const std::atomic<bool>& running, wait_mode mode, Poll poll)
+	{
+		auto ready = [&]()
+		{
+			return !running.load(std::memory_order_relaxed) || poll() > 0;
+		};
+
+		if (mode == wait_mode::park)
+		{
+			backoff_wait wait(0, 0);
+
+			while (running.load(std::memory_order_relaxed))
+			{
+				wait.wait(ready);
+			}
+		}
+		else
+		{
+			spin_wait wait;
+
+			while (running.load(std::memory_order_relaxed))
+			{
+				wait.wait(ready);
+			}
+		}
+	}
+
+
+	// Common part of the blocking strategies: the consumer announces
+	// itself before its last look at the queue, and the producer looks
+	// for sleepers after publishing. The two seq_cst fences order the
+	// queue position stores against the sleeper count either way, so a
+	// record is never published unseen while the consumer goes to sleep.
+	class sleeper_count
+	{
+	public:
+
+		sleeper_count() noexcept :
+			_sleepers(0)
+		{
+		}
+
+
+		bool any() const noexcept
+		{
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			return _sleepers.load(std::memory_order_relaxed) != 0;
+		}
+
+
+		void enter() noexcept
+		{
+			_sleepers.fetch_add(1, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+		}
+
+
+		void leave() noexcept
+		{
+			_sleepers.fetch_sub(1, std::memory_order_relaxed);
+		}
+
+
+	private:
+
+		std::atomic<std::uint32_t> _sleepers;
+
+	};
+
+
+#ifdef __linux__
+
+	// Sleeps in futex(2) after spins polls. The object may live in
+	// shared memory, e.g. queue metadata, to wake consumers in other
+	// processes.
+	class futex_wait
+	{
+	public:
+
+		explicit futex_wait(unsigned spins = 1000) noexcept :
+			_spins(spins),
+			_word(0)
+		{
+			static_assert(
+				sizeof (std::atomic<std::uint32_t>) == sizeof (std::uint32_t),
+				"futex word must be a plain 32-bit integer");
+		}
+
+
+		void notify() noexcept
+		{
+			if (_sleepers.any())
+			{
+				_word.fetch_add(1, std::memory_order_relaxed);
+				futex(FUTEX_WAKE, INT32_MAX);
+			}
+		}
+
+
+		template<typename Ready>
+		void wait(Ready ready)
+		{
+			for (unsigned i = 0; i < _spins; ++i)
+			{
+				if (ready())
+				{
+					return;
+				}
+			}
+
+			while (!ready())
+			{
+				auto word = _word.load(std::memory_order_relaxed);
+				_sleepers.enter();
+
+				if (!ready())
+				{
+					// Returns at once if notify() has bumped the word
+					// since it was read.
+					futex(FUTEX_WAIT, word);
+				}
+
+				_sleepers.leave();
+			}
+		}
+
+
+	private:
+
+		long futex(int op, std::uint32_t value) noexcept
+		{
+			return ::syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&_word), op, value, nullptr, nullptr, 0);
+		}
+
+
+		unsigned _spins;
+		sleeper_count _sleepers;
+		std::atomic<std::uint32_t> _word;
+
+	};
+
+
+	// Sleeps in read(2) on an eventfd after spins polls. The descriptor
+	// can be handed to another process or added to an epoll set.
+	class eventfd_wait
+	{
+	public:
+
+		explicit eventfd_wait(unsigned spins = 1000) :
+			_spins(spins),
+			_fd(::eventfd(0, EFD_CLOEXEC))
+		{
+			if (_fd < 0)
+			{
+				std::string what("eventfd: ");
+				what.append(::strerror(errno));
+				throw circular_queue_error(what);
+			}
+		}
+
+
+		~eventfd_wait()
+		{
+			::close(_fd);
+		}
+
+
+		eventfd_wait(const eventfd_wait&) = delete;
+		eventfd_wait& operator=(const eventfd_wait&) = delete;
+
+
+		int fd() const noexcept
+		{
+			return _fd;
+		}
+
+
+		void notify() noexcept
+		{
+			if (_sleepers.any())
+			{
+				std::uint64_t one = 1;
+				auto n = ::write(_fd, &one, sizeof one);
+				(void)n;
+			}
+		}
+
+
+		template<typename Ready>
+		void wait(Ready ready)
+		{
+			for (unsigned i = 0; i < _spins; ++i)
+			{
+				if (ready())
+				{
+					return;
+				}
+			}
+
+			while (!ready())
+			{
+				_sleepers.enter();
+
+				if (!ready())
+				{
+					// Stale wakeups from earlier notifies only cost a
+					// loop.
+					std::uint64_t count;
+					auto n = ::read(_fd, &count, sizeof count);
+					(void)n;
+				}
+
+				_sleepers.leave();
+			}
+		}
+
+
+	private:
+
+		unsigned _spins;
+		int _fd;
+		sleeper_count _sleepers;
+
+	};
+
+#endif
+
+}
+
+
+#endif
@@ -0,0 +1,297 @@
+//
+// Copyright (c) 2016 Dado Colussi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+#include <cstdint>
+#include <unistd.h>
+
+#include "catch.hpp"
+
+#if USE_C_API
+#include "gdc_circular_queue_factory.h"
+#else
+#include "gdc_circular_queue_factory.hpp"
+#endif
+
+#include "gdc_batch_tuner.hpp"
+
+
+namespace
+{
+	long page_size = ::sysconf(_SC_PAGESIZE);
+}
+
+
+SCENARIO("batched publish and release", "[batching]")
+{
+
+	typedef gdc::circular_queue_factory<char> F;
+	typedef typename F::value_type Q;
+	typedef gdc::framed_queue<Q> FQ;
+
+	F f(16 * page_size);
+	auto& q = f.get();
+	FQ producer(q);
+	FQ consumer(q);
+	auto fp = FQ::footprint(sizeof (std::uint64_t));
+
+
+	GIVEN("a producer publishing in batches of 4")
+	{
+
+		producer.set_publish_batch(4);
+
+		for (std::uint64_t i = 0; i < 3; ++i)
+		{
+			REQUIRE(producer.emplace<std::uint64_t>(i));
+		}
+
+		THEN("records are invisible until the batch is full")
+		{
+			CHECK(consumer.empty());
+			CHECK(producer.unpublished() == 3);
+			REQUIRE(producer.emplace<std::uint64_t>(3));
+			CHECK(producer.unpublished() == 0);
+			CHECK(q.available() == 4 * fp);
+		}
+
+		THEN("publish() makes a partial batch visible")
+		{
+			producer.publish();
+			auto h = consumer.peek();
+			REQUIRE(h != nullptr);
+			CHECK(*FQ::payload<std::uint64_t>(h) == 0);
+			CHECK(q.available() == 3 * fp);
+		}
+
+	}
+
+
+	GIVEN("a consumer releasing in batches of 4")
+	{
+
+		consumer.set_release_batch(4);
+
+		for (std::uint64_t i = 0; i < 6; ++i)
+		{
+			REQUIRE(producer.emplace<std::uint64_t>(i));
+		}
+
+		auto space = q.space();
+
+		THEN("space is handed back every 4 pops")
+		{
+			for (std::uint64_t i = 0; i < 3; ++i)
+			{
+				auto h = consumer.peek();
+				REQUIRE(h != nullptr);
+				CHECK(*FQ::payload<std::uint64_t>(h) == i);
+				consumer.pop();
+			}
+
+			CHECK(q.space() == space);
+			consumer.pop();
+			CHECK(q.space() == space + 4 * fp);
+		}
+
+		THEN("peek() releases when nothing is left")
+		{
+			for (std::uint64_t i = 0; i < 6; ++i)
+			{
+				consumer.pop();
+			}
+
+			CHECK(consumer.empty());
+			CHECK(consumer.unreleased() == 2);
+			CHECK(consumer.peek() == nullptr);
+			CHECK(q.empty());
+		}
+
+	}
+
+
+	GIVEN("a full queue with records held back")
+	{
+
+		producer.set_publish_batch(1000000);
+		std::uint64_t n = 0;
+
+		while (producer.emplace<std::uint64_t>(n))
+		{
+			++n;
+		}
+
+		THEN("the failing alloc publishes them")
+		{
+			CHECK(n > 0);
+			CHECK(producer.unpublished() == 0);
+			CHECK(q.available() == n * fp);
+		}
+
+	}
+
+
+	GIVEN("a publish tuner")
+	{
+
+		gdc::batch_limits limits;
+		gdc::publish_tuner<Q> tuner(producer, limits);
+		auto t = gdc::clock_ns();
+
+
+		WHEN("traffic is light")
+		{
+			for (std::uint64_t i = 0; i < 10; ++i)
+			{
+				REQUIRE(producer.emplace<std::uint64_t>(i));
+				consumer.pop();
+			}
+
+			tuner.poll(t + 2 * limits.interval_ns);
+
+			THEN("records are published one by one")
+			{
+				CHECK(tuner.batch() == 1);
+			}
+		}
+
+
+		WHEN("traffic is heavy")
+		{
+			for (std::uint64_t i = 0; i < 20000; ++i)
+			{
+				REQUIRE(producer.emplace<std::uint64_t>(i));
+
+				while (consumer.peek() != nullptr)
+				{
+					consumer.pop();
+				}
+			}
+
+			tuner.poll(t + limits.interval_ns);
+
+			THEN("batches grow up to the limit")
+			{
+				CHECK(tuner.batch() == limits.max_batch);
+			}
+		}
+
+
+		WHEN("the consumer lags behind")
+		{
+			while (q.available() < q.capacity() * 3 / 4)
+			{
+				REQUIRE(producer.emplace<std::uint64_t>(0));
+			}
+
+			tuner.poll(t + 1000 * limits.interval_ns);
+
+			THEN("batches go to the limit")
+			{
+				CHECK(tuner.batch() == limits.max_batch);
+			}
+		}
+
+	}
+
+
+	GIVEN("a publish tuner polled twice within one clock tick")
+	{
+
+		gdc::batch_limits limits;
+		limits.interval_ns = 0;
+		gdc::publish_tuner<Q> tuner(producer, limits);
+		REQUIRE(producer.emplace<std::uint64_t>(0));
+		auto t = gdc::clock_ns();
+		tuner.poll(t);
+		auto b = tuner.batch();
+		REQUIRE(producer.emplace<std::uint64_t>(1));
+		tuner.poll(t);
+
+		THEN("the second poll leaves the batch alone")
+		{
+			CHECK(tuner.batch() == b);
+		}
+
+	}
+
+
+	GIVEN("a publish tuner and records held back")
+	{
+
+		gdc::batch_limits limits;
+		limits.interval_ns = ~std::uint64_t(0) / 2;
+		gdc::publish_tuner<Q> tuner(producer, limits);
+		producer.set_publish_batch(limits.max_batch);
+		REQUIRE(producer.emplace<std::uint64_t>(0));
+		auto since = producer.unpublished_since();
+
+		THEN("they are published once the delay bound is reached")
+		{
+			tuner.poll(since + limits.max_delay_ns - 1);
+			CHECK(consumer.empty());
+			tuner.poll(since + limits.max_delay_ns);
+			CHECK_FALSE(consumer.empty());
+		}
+
+	}
+
+
+	GIVEN("a release tuner")
+	{
+
+		gdc::batch_limits limits;
+		gdc::release_tuner<Q> tuner(consumer, limits);
+		auto t = gdc::clock_ns();
+
+		WHEN("the queue stays nearly empty")
+		{
+			for (int i = 1; i <= 10; ++i)
+			{
+				tuner.poll(t + i * limits.interval_ns);
+			}
+
+			THEN("releases are batched up to the limit")
+			{
+				CHECK(tuner.batch() == limits.max_batch);
+			}
+
+			AND_WHEN("the queue fills up")
+			{
+				while (q.available() < q.capacity() * 3 / 4)
+				{
+					REQUIRE(producer.emplace<std::uint64_t>(0));
+				}
+
+				tuner.poll(t + 11 * limits.interval_ns);
+
+				THEN("the release batch shrinks")
+				{
+					CHECK(tuner.batch() == limits.max_batch / 2);
+				}
+			}
+		}
+
+	}
+
+}
@@ -5,6 +5,28 @@ SOURCES :=\
   main.cpp\
   factory.cpp\
   circular_queue.cpp\
+  framed_queue.cpp\
+  column_block.cpp\
+  delta_codec.cpp\
+  journal.cpp\
+  fragment.cpp\
+  pipeline.cpp\
+  merge_reader.cpp\
+  sequencer.cpp\
+  time_index.cpp\
+  metadata.cpp\
+  latest_value.cpp\
+  fifo_arena.cpp\
+  consumer.cpp\
+  batching.cpp\
+  rate_limiter.cpp\
+  load_generator.cpp\
+  wait_strategy.cpp\
+  memory_usage.cpp\
+  consumer_group.cpp\
+  tag_filter.cpp\
+  parallel_copy.cpp\
+  cpu_topology.cpp\
   ../src/gdc_circular_queue.c\
   ../src/gdc_circular_queue_factory.c
 TGT_POSTMAKE := $(TARGET_DIR)/$(TARGET)
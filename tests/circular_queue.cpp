@@ -295,6 +295,42 @@ SCENARIO("circular queue in single thread", "[queue]")
 		}
 
 
+		WHEN("queue is filled across the end of the buffer")
+		{
+			std::string hello("Hello World!");
+			size_type len = hello.length();
+
+			while (q.push(hello.c_str(), len))
+			{
+			}
+
+			q.pop(len);
+
+			while (q.push(hello.c_str(), len))
+			{
+			}
+
+			THEN("the queue is full, not empty")
+			{
+				CHECK_FALSE(q.empty());
+				CHECK(q.available() + q.space() == capacity - 1);
+				CHECK(q.space() < len);
+			}
+		}
+
+
+		WHEN("emplace() constructs the value in the queue")
+		{
+			REQUIRE(q.emplace('x'));
+
+			THEN("the value is available for reading")
+			{
+				REQUIRE(q.available() == 1);
+				REQUIRE(q.front() == 'x');
+			}
+		}
+
+
 		WHEN("push() + peek() + pop() 100000 times")
 		{
 			std::string hello("Hello World!");
@@ -0,0 +1,168 @@
+//
+// Copyright (c) 2016 Dado Colussi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+#include <chrono>
+#include <vector>
+#include <random>
+#include <iostream>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <unistd.h>
+
+#include "gdc_circular_queue_factory.hpp"
+#include "gdc_delta_codec.hpp"
+
+
+// Measures bytes per record and CPU cost of delta encoding a tick stream
+// through a framed queue, compared with pushing raw records.
+
+
+namespace
+{
+
+	struct tick
+	{
+		std::uint64_t time;
+		std::int64_t bid;
+		std::int64_t ask;
+		std::uint32_t bid_size;
+		std::uint32_t ask_size;
+		std::uint32_t instrument;
+		std::uint16_t venue;
+		std::uint16_t flags;
+	};
+
+
+	typedef gdc::circular_queue_factory<char> F;
+	typedef typename F::value_type Q;
+	typedef gdc::framed_queue<Q> FQ;
+	typedef std::chrono::steady_clock clock;
+
+
+	std::vector<tick> make_ticks(std::size_t n)
+	{
+		std::mt19937_64 rng(42);
+		std::vector<tick> v(n);
+		tick t;
+		std::memset(&t, 0, sizeof t);
+		t.time = 1500000000000000000ull;
+		t.bid = 1000000;
+		t.ask = 1000100;
+		t.instrument = 4711;
+		t.venue = 2;
+
+		for (auto& x : v)
+		{
+			t.time += 1000 + rng() % 5000;
+			auto r = rng() % 16;
+			if (r == 0) { t.bid += 1; t.ask += 1; }
+			if (r == 1) { t.bid -= 1; t.ask -= 1; }
+			if (r < 4) { t.bid_size = 100 * (1 + rng() % 10); }
+			if (r > 12) { t.ask_size = 100 * (1 + rng() % 10); }
+			x = t;
+		}
+
+		return v;
+	}
+
+
+	void report(const char* name, std::size_t n, std::size_t bytes, clock::duration d)
+	{
+		auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+		std::cout
+			<< name
+			<< ": " << static_cast<double>(bytes) / n << " bytes/record"
+			<< ", " << static_cast<double>(ns) / n << " ns/record"
+			<< std::endl;
+	}
+
+
+	void run()
+	{
+		long page_size = ::sysconf(_SC_PAGESIZE);
+		const std::size_t n = 1000000;
+		auto ticks = make_ticks(n);
+		F f(256 * page_size);
+		FQ fq(f.get());
+
+		// Raw records.
+		{
+			std::size_t bytes = 0;
+			tick out;
+			auto t0 = clock::now();
+
+			for (auto& t : ticks)
+			{
+				fq.push(&t, sizeof t);
+				auto h = fq.peek();
+				bytes += FQ::footprint(h->size);
+				std::memcpy(&out, FQ::payload(h), sizeof out);
+				fq.pop();
+			}
+
+			report("raw  ", n, bytes, clock::now() - t0);
+		}
+
+		// Delta encoded records.
+		{
+			gdc::delta_writer<Q, tick> w(fq);
+			gdc::delta_reader<Q, tick> r(fq);
+			std::size_t bytes = 0;
+			tick out;
+			auto t0 = clock::now();
+
+			for (auto& t : ticks)
+			{
+				w.push(t);
+				bytes += FQ::footprint(fq.peek()->size);
+				r.pop(out);
+			}
+
+			report("delta", n, bytes, clock::now() - t0);
+
+			if (std::memcmp(&out, &ticks.back(), sizeof out) != 0)
+			{
+				std::cerr << "decoded record mismatch" << std::endl;
+				std::exit(EXIT_FAILURE);
+			}
+		}
+	}
+
+}
+
+
+int
+main()
+{
+	try
+	{
+		run();
+	}
+	catch (const std::exception& ex)
+	{
+		std::cerr << ex.what() << std::endl;
+		exit(EXIT_FAILURE);
+	}
+}
@@ -0,0 +1,5 @@
+TARGET := codec_bench
+TGT_INCDIRS := ../src
+TGT_DEFS :=
+TGT_CXXFLAGS := -O2
+SOURCES := codec_bench.cpp
@@ -0,0 +1,142 @@
+//
+// Copyright (c) 2016 Dado Colussi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+#include <cstdint>
+#include <cstddef>
+#include <unistd.h>
+
+#include "catch.hpp"
+
+#if USE_C_API
+#include "gdc_circular_queue_factory.h"
+#else
+#include "gdc_circular_queue_factory.hpp"
+#endif
+
+#include "gdc_column_block.hpp"
+
+
+namespace
+{
+	long page_size = ::sysconf(_SC_PAGESIZE);
+}
+
+
+SCENARIO("column blocks", "[column]")
+{
+
+	typedef gdc::circular_queue_factory<char> F;
+	typedef typename F::value_type Q;
+	typedef gdc::framed_queue<Q> FQ;
+	typedef gdc::column_block<256, double, std::uint32_t, std::uint64_t> B;
+
+
+	GIVEN("a column block writer")
+	{
+
+		F f(64 * page_size);
+		FQ fq(f.get());
+		gdc::column_block_writer<Q, B> w(fq);
+
+
+		WHEN("appending more rows than fit in one block")
+		{
+			for (std::uint32_t i = 0; i < 300; ++i)
+			{
+				REQUIRE(w.append(i * 0.5, i, std::uint64_t(1000) + i));
+			}
+
+			THEN("the first block is published when full")
+			{
+				auto h = fq.peek();
+				REQUIRE(h != nullptr);
+				gdc::column_block_view<B> v(h);
+				CHECK(v.rows() == 256);
+				fq.pop();
+				CHECK(fq.peek() == nullptr);
+			}
+
+			THEN("flush() publishes the partial block")
+			{
+				REQUIRE(w.flush());
+				fq.pop();
+				auto h = fq.peek();
+				REQUIRE(h != nullptr);
+				gdc::column_block_view<B> v(h);
+				REQUIRE(v.rows() == 44);
+				CHECK(v.column<0>()[0] == 128.0);
+				CHECK(v.column<1>()[43] == 299);
+				CHECK(v.column<2>()[43] == 1299);
+			}
+
+			THEN("columns are aligned for vector loads")
+			{
+				auto h = fq.peek();
+				REQUIRE(h != nullptr);
+				gdc::column_block_view<B> v(h);
+				auto a = B::column_alignment;
+				CHECK(reinterpret_cast<std::uintptr_t>(v.column<0>()) % a == 0);
+				CHECK(reinterpret_cast<std::uintptr_t>(v.column<1>()) % a == 0);
+				CHECK(reinterpret_cast<std::uintptr_t>(v.column<2>()) % a == 0);
+
+				std::uint64_t sum = 0;
+				for (std::size_t i = 0; i < v.rows(); ++i)
+				{
+					sum += v.column<1>()[i];
+				}
+				CHECK(sum == 255 * 256 / 2);
+			}
+		}
+
+
+		WHEN("filling columns in bulk")
+		{
+			REQUIRE(w.open());
+			auto price = w.column<0>();
+			auto size = w.column<1>();
+			auto time = w.column<2>();
+
+			for (std::uint32_t i = 0; i < 10; ++i)
+			{
+				price[i] = 1.5;
+				size[i] = i;
+				time[i] = i;
+			}
+
+			w.commit_rows(10);
+			REQUIRE(w.flush());
+
+			THEN("the block holds the rows")
+			{
+				auto h = fq.peek();
+				REQUIRE(h != nullptr);
+				gdc::column_block_view<B> v(h);
+				CHECK(v.rows() == 10);
+				CHECK(v.column<0>()[9] == 1.5);
+			}
+		}
+
+	}
+
+}
@@ -0,0 +1,154 @@
+//
+// Copyright (c) 2016 Dado Colussi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+#include <thread>
+#include <chrono>
+#include <cstdint>
+#include <unistd.h>
+
+#include "catch.hpp"
+
+#if USE_C_API
+#include "gdc_circular_queue_factory.h"
+#else
+#include "gdc_circular_queue_factory.hpp"
+#endif
+
+#include "gdc_framed_queue.hpp"
+#include "gdc_consumer.hpp"
+
+
+namespace
+{
+	long page_size = ::sysconf(_SC_PAGESIZE);
+}
+
+
+SCENARIO("consumer runtime", "[consumer]")
+{
+
+	typedef gdc::circular_queue_factory<char> F;
+	typedef typename F::value_type Q;
+	typedef gdc::framed_queue<Q> FQ;
+
+
+	GIVEN("a consumer draining two queues")
+	{
+
+		F f1(16 * page_size);
+		F f2(16 * page_size);
+		FQ p1(f1.get());
+		FQ p2(f2.get());
+		FQ q1(f1.get());
+		FQ q2(f2.get());
+		std::uint64_t sum1 = 0;
+		std::uint64_t sum2 = 0;
+
+		auto drain = [](FQ& q, std::uint64_t& sum) -> std::size_t
+		{
+			std::size_t n = 0;
+
+			for (auto h = q.peek(); h != nullptr; h = q.peek())
+			{
+				sum += *FQ::payload<std::uint32_t>(h);
+				q.pop();
+				++n;
+			}
+
+			return n;
+		};
+
+		gdc::consumer_options options;
+		options.wait = gdc::wait_mode::park;
+		options.cpu = ::sched_getcpu();
+		gdc::consumer_runtime c(options);
+		c.add_handler("first", [&]() { return drain(q1, sum1); });
+		c.add_handler("second", [&]() { return drain(q2, sum2); });
+		c.start();
+
+		const std::uint32_t n = 5000;
+
+		for (std::uint32_t i = 1; i <= n; ++i)
+		{
+			while (!p1.emplace<std::uint32_t>(i))
+			{
+				std::this_thread::yield();
+			}
+
+			while (!p2.emplace<std::uint32_t>(2 * i))
+			{
+				std::this_thread::yield();
+			}
+		}
+
+		while (!p1.empty() || !p2.empty())
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+
+		c.stop();
+		auto st = c.statistics();
+
+		THEN("all records are consumed and accounted for")
+		{
+			CHECK(sum1 == std::uint64_t(n) * (n + 1) / 2);
+			CHECK(sum2 == std::uint64_t(n) * (n + 1));
+			REQUIRE(st.handlers.size() == 2);
+			CHECK(st.handlers[0].name == "first");
+			CHECK(st.handlers[0].records == n);
+			CHECK(st.handlers[1].records == n);
+			CHECK(st.handlers[0].calls == st.busy_iterations + st.idle_iterations);
+			CHECK(st.handlers[0].busy_calls <= st.busy_iterations);
+			CHECK(st.busy_iterations > 0);
+			CHECK(st.handlers[0].nanoseconds > 0);
+			CHECK(st.wall_nanoseconds >= st.handlers[0].nanoseconds);
+			CHECK(st.cpu_nanoseconds > 0);
+		}
+
+	}
+
+
+	GIVEN("a consumer that cannot apply its scheduling options")
+	{
+
+		gdc::consumer_options options;
+		options.wait = gdc::wait_mode::park;
+		options.fifo_priority = 1000;
+		gdc::consumer_runtime c(options);
+		c.add_handler("idle", []() -> std::size_t { return 0; });
+		c.start();
+
+		while (c.running())
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+
+		THEN("stop() reports the error")
+		{
+			REQUIRE_THROWS_AS(c.stop(), gdc::circular_queue_error&);
+		}
+
+	}
+
+}
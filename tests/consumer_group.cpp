@@ -0,0 +1,199 @@
+//
+// Copyright (c) 2016 Dado Colussi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <cstdint>
+#include <unistd.h>
+
+#include "catch.hpp"
+
+#if USE_C_API
+#include "gdc_circular_queue_factory.h"
+#else
+#include "gdc_circular_queue_factory.hpp"
+#endif
+
+#include "gdc_consumer_group.hpp"
+
+
+namespace
+{
+	long page_size = ::sysconf(_SC_PAGESIZE);
+}
+
+
+SCENARIO("competing consumers", "[consumer_group]")
+{
+
+	typedef gdc::circular_queue_factory<char> F;
+	typedef typename F::value_type Q;
+	typedef gdc::framed_queue<Q> FQ;
+	typedef gdc::consumer_group<Q> G;
+
+	auto init = [](Q& q) { return G::init(q); };
+	F f(4 * page_size, true, G::footprint(), init);
+	auto& q = f.get();
+	FQ producer(q);
+
+
+	GIVEN("two members and batches finished out of order")
+	{
+
+		G a(q, 0);
+		G b(q, 1);
+
+		for (std::uint64_t i = 0; i < 10; ++i)
+		{
+			REQUIRE(producer.emplace<std::uint64_t>(i));
+		}
+
+		auto used = q.available();
+		auto ba = a.claim(4);
+		auto bb = b.claim(4);
+
+		THEN("each member gets its own records")
+		{
+			REQUIRE(ba.records == 4);
+			REQUIRE(bb.records == 4);
+			std::uint64_t expected = 0;
+
+			for (auto h = ba.first; h != nullptr; h = ba.next(h))
+			{
+				CHECK(*FQ::payload<std::uint64_t>(h) == expected++);
+			}
+
+			for (auto h = bb.first; h != nullptr; h = bb.next(h))
+			{
+				CHECK(*FQ::payload<std::uint64_t>(h) == expected++);
+			}
+
+			CHECK(expected == 8);
+		}
+
+		THEN("rpos waits for the earlier batch")
+		{
+			b.complete(bb);
+			CHECK(q.available() == used);
+			a.complete(ba);
+			CHECK(q.available() == used - ba.bytes - bb.bytes);
+		}
+
+		THEN("the rest is claimed and then nothing is left")
+		{
+			a.complete(ba);
+			b.complete(bb);
+			auto rest = a.claim(100);
+			CHECK(rest.records == 2);
+			a.complete(rest);
+			CHECK_FALSE(b.claim(100));
+			CHECK(q.empty());
+		}
+
+	}
+
+
+	GIVEN("a producer feeding three member threads")
+	{
+
+		const std::uint64_t n = 200000;
+		std::vector<std::atomic<int>> seen(n);
+		std::atomic<std::uint64_t> processed(0);
+		std::vector<std::thread> members;
+
+		for (auto& s : seen)
+		{
+			s.store(0);
+		}
+
+		for (std::size_t id = 0; id < 3; ++id)
+		{
+			members.emplace_back([&, id]()
+			{
+				G g(q, id);
+
+				while (processed.load() < n)
+				{
+					auto batch = g.claim(16);
+
+					if (!batch)
+					{
+						std::this_thread::yield();
+						continue;
+					}
+
+					for (auto h = batch.first; h != nullptr; h = batch.next(h))
+					{
+						++seen[*FQ::payload<std::uint64_t>(h)];
+					}
+
+					g.complete(batch);
+					processed += batch.records;
+				}
+			});
+		}
+
+		for (std::uint64_t i = 0; i < n; ++i)
+		{
+			while (!producer.emplace<std::uint64_t>(i))
+			{
+				std::this_thread::yield();
+			}
+		}
+
+		for (auto& t : members)
+		{
+			t.join();
+		}
+
+		THEN("every record is processed exactly once and the queue drains")
+		{
+			std::uint64_t once = 0;
+
+			for (auto& s : seen)
+			{
+				once += s.load() == 1;
+			}
+
+			CHECK(once == n);
+			CHECK(processed.load() == n);
+			CHECK(q.empty());
+		}
+
+	}
+
+
+	GIVEN("a member id out of range")
+	{
+
+		THEN("attaching throws")
+		{
+			CHECK_THROWS_AS(G(q, gdc::consumer_group_max_members), gdc::circular_queue_error&);
+		}
+
+	}
+
+}
@@ -4,5 +4,27 @@ TGT_DEFS :=
 SOURCES :=\
   main.cpp\
   factory.cpp\
-  circular_queue.cpp
+  circular_queue.cpp\
+  framed_queue.cpp\
+  column_block.cpp\
+  delta_codec.cpp\
+  journal.cpp\
+  fragment.cpp\
+  pipeline.cpp\
+  merge_reader.cpp\
+  sequencer.cpp\
+  time_index.cpp\
+  metadata.cpp\
+  latest_value.cpp\
+  fifo_arena.cpp\
+  consumer.cpp\
+  batching.cpp\
+  rate_limiter.cpp\
+  load_generator.cpp\
+  wait_strategy.cpp\
+  memory_usage.cpp\
+  consumer_group.cpp\
+  tag_filter.cpp\
+  parallel_copy.cpp\
+  cpu_topology.cpp
 TGT_POSTMAKE := $(TARGET_DIR)/$(TARGET)
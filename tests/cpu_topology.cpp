@@ -0,0 +1,233 @@
+//
+// Copyright (c) 2016 Dado Colussi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "catch.hpp"
+
+#include "gdc_topology.hpp"
+
+
+namespace
+{
+
+	// A sysfs CPU tree in a temporary directory, removed on destruction.
+	class fake_sysfs
+	{
+	public:
+
+		fake_sysfs()
+		{
+			char path[] = "/tmp/gdc_sysfsXXXXXX";
+			REQUIRE(::mkdtemp(path) != nullptr);
+			_root = path;
+			_dirs.push_back(_root);
+		}
+
+
+		~fake_sysfs()
+		{
+			for (auto i = _files.rbegin(); i != _files.rend(); ++i)
+			{
+				::unlink(i->c_str());
+			}
+
+			for (auto i = _dirs.rbegin(); i != _dirs.rend(); ++i)
+			{
+				::rmdir(i->c_str());
+			}
+		}
+
+
+		const std::string& root() const
+		{
+			return _root;
+		}
+
+
+		void write(const std::string& path, const std::string& value)
+		{
+			std::string::size_type slash = 0;
+
+			while ((slash = path.find('/', slash + 1)) != std::string::npos)
+			{
+				auto dir = _root + "/" + path.substr(0, slash);
+
+				if (::mkdir(dir.c_str(), 0700) == 0)
+				{
+					_dirs.push_back(dir);
+				}
+			}
+
+			auto file = _root + "/" + path;
+			std::ofstream(file) << value << "\n";
+			_files.push_back(file);
+		}
+
+
+		void cache(int cpu, int index, int level, const std::string& type, const std::string& shared)
+		{
+			auto dir = "cpu" + std::to_string(cpu) + "/cache/index" + std::to_string(index);
+			write(dir + "/level", std::to_string(level));
+			write(dir + "/type", type);
+			write(dir + "/shared_cpu_list", shared);
+		}
+
+
+		void topology(int cpu, int core, int package, int die, const std::string& siblings)
+		{
+			auto dir = "cpu" + std::to_string(cpu) + "/topology";
+			write(dir + "/core_id", std::to_string(core));
+			write(dir + "/physical_package_id", std::to_string(package));
+			write(dir + "/die_id", std::to_string(die));
+			write(dir + "/thread_siblings_list", siblings);
+		}
+
+
+	private:
+
+		std::string _root;
+		std::vector<std::string> _dirs;
+		std::vector<std::string> _files;
+
+	};
+
+}
+
+
+SCENARIO("CPU lists and topology from sysfs", "[topology]")
+{
+
+	GIVEN("kernel CPU lists")
+	{
+
+		THEN("ranges and single CPUs are expanded")
+		{
+			CHECK(gdc::parse_cpu_list("0-3,8,10-11") == std::vector<int>({0, 1, 2, 3, 8, 10, 11}));
+			CHECK(gdc::parse_cpu_list("5") == std::vector<int>({5}));
+		}
+
+		THEN("an empty list has no CPUs")
+		{
+			CHECK(gdc::parse_cpu_list("").empty());
+		}
+
+	}
+
+
+	GIVEN("a tree with SMT, L2, LLC, dies and packages")
+	{
+
+		// Package 0, die 0: cores 0 (CPUs 0 and 1), 1 (CPU 2) and 2
+		// (CPU 3). CPUs 0-2 share an L2, 0-3 the LLC. CPU 8 is on die 0
+		// without cache entries, CPU 10 on die 1, CPU 11 in package 1
+		// with only its package id.
+		fake_sysfs sys;
+		sys.write("online", "0-3,8,10-11");
+
+		for (int cpu = 0; cpu < 2; ++cpu)
+		{
+			sys.topology(cpu, 0, 0, 0, "0-1");
+			sys.cache(cpu, 0, 1, "Data", "0-1");
+			sys.cache(cpu, 1, 1, "Instruction", "0-1");
+			sys.cache(cpu, 2, 2, "Unified", "0-2");
+			sys.cache(cpu, 3, 3, "Unified", "0-3");
+		}
+
+		sys.topology(2, 1, 0, 0, "2");
+		sys.cache(2, 0, 2, "Unified", "0-2");
+		sys.cache(2, 1, 3, "Unified", "0-3");
+		sys.topology(3, 2, 0, 0, "3");
+		sys.cache(3, 0, 2, "Unified", "3");
+		sys.cache(3, 1, 3, "Unified", "0-3");
+		sys.topology(8, 3, 0, 0, "8");
+		sys.topology(10, 0, 0, 1, "10");
+		sys.write("cpu11/topology/physical_package_id", "1");
+
+		auto cpus = gdc::read_cpu_topology(sys.root());
+		REQUIRE(cpus.size() == 7);
+
+		auto cpu = [&cpus](int n) -> const gdc::cpu_info&
+		{
+			for (auto& c : cpus)
+			{
+				if (c.cpu == n)
+				{
+					return c;
+				}
+			}
+
+			FAIL("cpu " << n << " not found");
+			return cpus.front();
+		};
+
+		THEN("caches are read from the data and unified entries")
+		{
+			CHECK(cpu(0).smt_siblings == std::vector<int>({0, 1}));
+			CHECK(cpu(0).l2_sharers == std::vector<int>({0, 1, 2}));
+			CHECK(cpu(0).llc_sharers == std::vector<int>({0, 1, 2, 3}));
+		}
+
+		THEN("missing entries leave a CPU on its own")
+		{
+			CHECK(cpu(8).l2_sharers == std::vector<int>({8}));
+			CHECK(cpu(8).llc_sharers == std::vector<int>({8}));
+			CHECK(cpu(11).core == 11);
+			CHECK(cpu(11).die == 0);
+			CHECK(cpu(11).smt_siblings == std::vector<int>({11}));
+		}
+
+		THEN("relations go from the same CPU to another package")
+		{
+			CHECK(gdc::relation(cpu(0), cpu(0)) == gdc::cpu_relation::same_cpu);
+			CHECK(gdc::relation(cpu(0), cpu(1)) == gdc::cpu_relation::smt_sibling);
+			CHECK(gdc::relation(cpu(0), cpu(2)) == gdc::cpu_relation::shared_l2);
+			CHECK(gdc::relation(cpu(0), cpu(3)) == gdc::cpu_relation::shared_llc);
+			CHECK(gdc::relation(cpu(0), cpu(8)) == gdc::cpu_relation::same_package);
+			CHECK(gdc::relation(cpu(0), cpu(10)) == gdc::cpu_relation::same_package_other_die);
+			CHECK(gdc::relation(cpu(0), cpu(11)) == gdc::cpu_relation::remote);
+		}
+
+	}
+
+
+	GIVEN("a tree without CPUs")
+	{
+
+		fake_sysfs sys;
+
+		THEN("no CPUs are read")
+		{
+			CHECK(gdc::read_cpu_topology(sys.root()).empty());
+		}
+
+	}
+
+}
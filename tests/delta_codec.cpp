@@ -0,0 +1,152 @@
+//
+// Copyright (c) 2016 Dado Colussi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+#include <cstdint>
+#include <cstring>
+#include <unistd.h>
+
+#include "catch.hpp"
+
+#if USE_C_API
+#include "gdc_circular_queue_factory.h"
+#else
+#include "gdc_circular_queue_factory.hpp"
+#endif
+
+#include "gdc_delta_codec.hpp"
+
+
+namespace
+{
+	long page_size = ::sysconf(_SC_PAGESIZE);
+
+
+	struct tick
+	{
+		std::uint64_t time;
+		std::int64_t price;
+		std::uint32_t size;
+		std::uint16_t venue;
+		char flags;
+	};
+
+
+	bool operator==(const tick& a, const tick& b)
+	{
+		return std::memcmp(&a, &b, sizeof a) == 0;
+	}
+}
+
+
+SCENARIO("delta codec", "[codec]")
+{
+
+	typedef gdc::circular_queue_factory<char> F;
+	typedef typename F::value_type Q;
+	typedef gdc::framed_queue<Q> FQ;
+
+
+	GIVEN("a delta codec")
+	{
+
+		gdc::delta_codec<tick> enc;
+		gdc::delta_codec<tick> dec;
+		unsigned char buf[gdc::delta_codec<tick>::max_size];
+		tick t;
+		std::memset(&t, 0, sizeof t);
+		t.time = 1000000;
+		t.price = 12345;
+		t.size = 100;
+		t.venue = 3;
+
+
+		WHEN("encoding a record equal to the previous one")
+		{
+			enc.encode(t, buf);
+			dec.decode(buf, t);
+			auto n = enc.encode(t, buf);
+
+			THEN("only the bitmap is written")
+			{
+				REQUIRE(n == gdc::delta_codec<tick>::bitmap_size);
+			}
+		}
+
+
+		WHEN("fields change by small amounts in both directions")
+		{
+			tick out;
+			enc.encode(t, buf);
+			dec.decode(buf, out);
+			t.time += 17;
+			t.price -= 3;
+			auto n = enc.encode(t, buf);
+
+			THEN("the record is smaller than the original and decodes back")
+			{
+				CHECK(n < sizeof (tick) / 2);
+				REQUIRE(dec.decode(buf, out) == n);
+				CHECK(out == t);
+			}
+		}
+
+	}
+
+
+	GIVEN("a delta writer and reader on a framed queue")
+	{
+
+		F f(10 * page_size);
+		FQ fq(f.get());
+		gdc::delta_writer<Q, tick> w(fq);
+		gdc::delta_reader<Q, tick> r(fq);
+
+
+		WHEN("streaming many records through the queue")
+		{
+			tick t;
+			std::memset(&t, 0, sizeof t);
+
+			THEN("every record is decoded in order")
+			{
+				for (int i = 0; i < 100000; ++i)
+				{
+					CAPTURE(i);
+					t.time += 1 + i % 7;
+					t.price += (i % 3) - 1;
+					t.size = i % 5 == 0 ? 200 : 100;
+					REQUIRE(w.push(t));
+					tick out;
+					REQUIRE(r.pop(out));
+					REQUIRE(out == t);
+				}
+
+				tick out;
+				REQUIRE_FALSE(r.pop(out));
+			}
+		}
+
+	}
+
+}
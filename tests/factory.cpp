@@ -26,7 +26,11 @@
 #include <cstring>
 #include <thread>
 #include <future>
+#include <cstdint>
+#include <cerrno>
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
 
 #include "catch.hpp"
 
@@ -122,6 +126,85 @@ SCENARIO("C/C++ circular queue factory", "[factory]")
 		}
 
 
+		WHEN("the shared queue was created with another control block padding")
+		{
+			F f(name, 10 * page_size);
+			auto p = reinterpret_cast<char*>(&f.get());
+			std::uint32_t padding;
+			std::memcpy(&padding, p + sizeof (std::size_t) + 4, sizeof padding);
+			CHECK(padding == GDC_CONTROL_BLOCK_PADDING);
+			padding *= 2;
+			std::memcpy(p + sizeof (std::size_t) + 4, &padding, sizeof padding);
+
+			THEN("mapping the queue throws gdc::circular_queue_error")
+			{
+				F ff(name);
+				REQUIRE_THROWS_AS(ff.get(), gdc::circular_queue_error&);
+			}
+		}
+
+
+		WHEN("a small shared queue was created with another control block padding")
+		{
+			// A build with less padding can make a queue shorter than
+			// our control block. Only the first page matters here.
+			char layout[sizeof (std::size_t) + 8];
+			{
+				F f(name, page_size);
+				std::memcpy(layout, &f.get(), sizeof layout);
+			}
+			std::uint32_t padding;
+			std::memcpy(&padding, layout + sizeof (std::size_t) + 4, sizeof padding);
+			padding /= 2;
+			std::memcpy(layout + sizeof (std::size_t) + 4, &padding, sizeof padding);
+
+			int fd = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, S_IRWXU);
+			REQUIRE(fd != -1);
+			REQUIRE(::ftruncate(fd, page_size) == 0);
+			REQUIRE(::pwrite(fd, layout, sizeof layout, 0) == static_cast<ssize_t>(sizeof layout));
+			::close(fd);
+
+			THEN("mapping the queue fails with a layout mismatch")
+			{
+#if USE_C_API
+				errno = 0;
+				CHECK(::gdc_circular_queue_map_shared(name.c_str()) == nullptr);
+				CHECK(errno == EPROTO);
+#else
+				F ff(name);
+				REQUIRE_THROWS_AS(ff.get(), gdc::circular_queue_error&);
+#endif
+			}
+
+			F::delete_shared(name);
+		}
+
+
+		WHEN("a shared queue has no layout record")
+		{
+			// Zeroed like a queue still being created, or one created by
+			// a build that predates the layout record.
+			int fd = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, S_IRWXU);
+			REQUIRE(fd != -1);
+			REQUIRE(::ftruncate(fd, 16 * page_size) == 0);
+			::close(fd);
+
+			THEN("mapping the queue fails")
+			{
+#if USE_C_API
+				errno = 0;
+				CHECK(::gdc_circular_queue_map_shared(name.c_str()) == nullptr);
+				CHECK(errno == EAGAIN);
+#else
+				F ff(name);
+				REQUIRE_THROWS_AS(ff.get(), gdc::circular_queue_error&);
+#endif
+			}
+
+			F::delete_shared(name);
+		}
+
+
 		WHEN("the shared queue doesn't exist")
 		{
 			THEN("can_get() returns false")
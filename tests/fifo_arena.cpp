@@ -0,0 +1,184 @@
+//
+// Copyright (c) 2016 Dado Colussi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+#include <vector>
+#include <new>
+#include <cstdint>
+#include <unistd.h>
+
+#include "catch.hpp"
+
+#if USE_C_API
+#include "gdc_circular_queue_factory.h"
+#else
+#include "gdc_circular_queue_factory.hpp"
+#endif
+
+#include "gdc_fifo_arena.hpp"
+
+
+namespace
+{
+	long page_size = ::sysconf(_SC_PAGESIZE);
+}
+
+
+SCENARIO("FIFO arena memory resource", "[fifo_arena]")
+{
+
+	typedef gdc::circular_queue_factory<char> F;
+	typedef typename F::value_type Q;
+	typedef gdc::fifo_arena<Q> A;
+
+
+	GIVEN("an arena over a private queue")
+	{
+
+		F f(4 * page_size, false);
+		auto& q = f.get();
+		A a(q);
+
+
+		WHEN("allocating blocks with various alignments")
+		{
+			auto p1 = a.allocate(10, 1);
+			auto p2 = a.allocate(100, 64);
+			auto p3 = a.allocate(8, 8);
+
+			THEN("blocks are aligned and don't overlap")
+			{
+				auto u1 = reinterpret_cast<std::uintptr_t>(p1);
+				auto u2 = reinterpret_cast<std::uintptr_t>(p2);
+				auto u3 = reinterpret_cast<std::uintptr_t>(p3);
+				CHECK(u2 % 64 == 0);
+				CHECK(u3 % 8 == 0);
+				CHECK(u2 >= u1 + 10);
+				CHECK(u3 >= u2 + 100);
+				CHECK(a.outstanding() == 3);
+			}
+
+			a.deallocate(p1, 10, 1);
+			a.deallocate(p2, 100, 64);
+			a.deallocate(p3, 8, 8);
+		}
+
+
+		WHEN("releasing blocks out of order")
+		{
+			auto p1 = a.allocate(32);
+			auto p2 = a.allocate(32);
+			auto p3 = a.allocate(32);
+			auto used = a.used();
+			a.deallocate(p2, 32);
+
+			THEN("space is reclaimed once the older blocks are released")
+			{
+				CHECK(a.used() == used);
+				a.deallocate(p1, 32);
+				CHECK(a.used() < used);
+				CHECK(a.used() > 0);
+				a.deallocate(p3, 32);
+				CHECK(a.used() == 0);
+				CHECK(a.outstanding() == 0);
+			}
+		}
+
+
+		WHEN("the arena is full")
+		{
+			std::vector<void*> blocks;
+
+			try
+			{
+				for (;;)
+				{
+					blocks.push_back(a.allocate(1000));
+				}
+			}
+			catch (const std::bad_alloc&)
+			{
+			}
+
+			THEN("allocation throws until the oldest block is released")
+			{
+				CHECK(blocks.size() >= 3);
+				a.deallocate(blocks.front(), 1000);
+				blocks.front() = a.allocate(1000);
+
+				for (auto p : blocks)
+				{
+					a.deallocate(p, 1000);
+				}
+
+				CHECK(q.empty());
+			}
+		}
+
+
+		WHEN("cycling allocations around the ring")
+		{
+			bool intact = true;
+
+			for (std::uint32_t i = 0; i < 10000; ++i)
+			{
+				auto p = static_cast<std::uint32_t*>(a.allocate(48 * sizeof (std::uint32_t)));
+				p[0] = i;
+				p[47] = i;
+				intact = intact && p[0] == p[47];
+				a.deallocate(p, 48 * sizeof (std::uint32_t));
+			}
+
+			THEN("blocks wrap without corruption")
+			{
+				CHECK(intact);
+				CHECK(q.empty());
+			}
+		}
+
+
+		WHEN("backing a standard container")
+		{
+			typedef gdc::resource_allocator<std::uint64_t> Alloc;
+
+			{
+				std::vector<std::uint64_t, Alloc> v{Alloc(&a)};
+
+				for (std::uint64_t i = 0; i < 200; ++i)
+				{
+					v.push_back(i);
+				}
+
+				CHECK(v[199] == 199);
+			}
+
+			THEN("all its memory is returned")
+			{
+				CHECK(a.outstanding() == 0);
+				CHECK(q.empty());
+			}
+		}
+
+	}
+
+}
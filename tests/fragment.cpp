@@ -0,0 +1,227 @@
+//
+// Copyright (c) 2016 Dado Colussi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+#include <string>
+#include <vector>
+#include <future>
+#include <cstdint>
+#include <cstring>
+#include <unistd.h>
+
+#include "catch.hpp"
+
+#if USE_C_API
+#include "gdc_circular_queue_factory.h"
+#else
+#include "gdc_circular_queue_factory.hpp"
+#endif
+
+#include "gdc_fragment.hpp"
+
+
+namespace
+{
+	long page_size = ::sysconf(_SC_PAGESIZE);
+}
+
+
+SCENARIO("large message fragmentation", "[fragment]")
+{
+
+	typedef gdc::circular_queue_factory<char> F;
+	typedef typename F::value_type Q;
+	typedef gdc::framed_queue<Q> FQ;
+
+
+	GIVEN("a message larger than the queue")
+	{
+
+		F f(4 * page_size);
+		FQ fq(f.get());
+		gdc::fragment_writer<Q> w(fq, page_size / 2);
+		gdc::fragment_reader<Q> r(fq);
+
+		std::vector<char> message(100 * page_size + 17);
+		for (std::size_t i = 0; i < message.size(); ++i)
+		{
+			message[i] = static_cast<char>(i * 31);
+		}
+
+
+		WHEN("producer and consumer alternate")
+		{
+			std::vector<char> buf(message.size());
+			REQUIRE(w.start(message.data(), message.size(), 9));
+			CHECK_FALSE(w.start(message.data(), message.size()));
+
+			bool sent = false;
+			bool received = false;
+
+			while (!received)
+			{
+				sent = sent || w.send();
+				received = r.read(buf.data(), buf.size());
+			}
+
+			THEN("the message is reassembled")
+			{
+				CHECK(sent);
+				CHECK_FALSE(w.busy());
+				CHECK(r.size() == message.size());
+				CHECK(r.tag() == 9);
+				CHECK(buf == message);
+				CHECK(fq.empty());
+			}
+		}
+
+
+		WHEN("producer and consumer run in different threads")
+		{
+			std::vector<char> buf(message.size());
+
+			auto producer = std::async(std::launch::async, [&]()
+			{
+				for (int i = 0; i < 10; ++i)
+				{
+					w.start(message.data(), message.size());
+					while (!w.send())
+					{
+					}
+				}
+			});
+
+			int n = 0;
+			while (n < 10)
+			{
+				if (r.read(buf.data(), buf.size()))
+				{
+					REQUIRE(buf == message);
+					++n;
+				}
+			}
+
+			producer.wait();
+
+			THEN("every message is received")
+			{
+				CHECK(n == 10);
+			}
+		}
+
+
+		WHEN("the buffer is too small")
+		{
+			std::vector<char> buf(message.size() - 1);
+			w.start(message.data(), message.size());
+			w.send();
+
+			THEN("read() throws and message_size() tells the size")
+			{
+				REQUIRE_THROWS_AS(r.read(buf.data(), buf.size()), gdc::circular_queue_error&);
+				CHECK(r.message_size() == message.size());
+			}
+		}
+
+	}
+
+
+	GIVEN("an unfragmented record")
+	{
+
+		F f(4 * page_size);
+		FQ fq(f.get());
+		gdc::fragment_reader<Q> r(fq);
+		std::string hello("Hello World!");
+		fq.push(hello.data(), hello.size(), 3);
+
+		THEN("it is read as a message")
+		{
+			char buf[32];
+			REQUIRE(r.read(buf, sizeof buf));
+			CHECK(std::string(buf, r.size()) == hello);
+			CHECK(r.tag() == 3);
+		}
+
+	}
+
+
+	GIVEN("malformed fragments")
+	{
+
+		F f(4 * page_size);
+		FQ fq(f.get());
+		gdc::fragment_reader<Q> r(fq);
+		char buf[64];
+
+		auto commit_fragment = [&fq](std::uint64_t size, std::size_t n, std::uint16_t flags)
+		{
+			auto p = static_cast<char*>(fq.alloc(sizeof (gdc::fragment_header) + n));
+			REQUIRE(p != nullptr);
+			std::memcpy(p, &size, sizeof size);
+			fq.commit(n, 0, flags);
+		};
+
+
+		WHEN("the first fragment is shorter than a fragment header")
+		{
+			commit_fragment(16, sizeof (gdc::fragment_header) - 1,
+				gdc::record_fragment | gdc::record_first_fragment);
+
+			THEN("read() throws")
+			{
+				REQUIRE_THROWS_AS(r.read(buf, sizeof buf), gdc::circular_queue_error&);
+			}
+		}
+
+
+		WHEN("the fragments are longer than the message")
+		{
+			commit_fragment(16, sizeof (gdc::fragment_header) + 8,
+				gdc::record_fragment | gdc::record_first_fragment);
+			commit_fragment(0, 16,
+				gdc::record_fragment | gdc::record_last_fragment);
+
+			THEN("read() throws instead of writing past the message")
+			{
+				REQUIRE_THROWS_AS(r.read(buf, sizeof buf), gdc::circular_queue_error&);
+			}
+		}
+
+
+		WHEN("the fragments are shorter than the message")
+		{
+			commit_fragment(16, sizeof (gdc::fragment_header) + 8,
+				gdc::record_fragment | gdc::record_first_fragment);
+			commit_fragment(0, 4,
+				gdc::record_fragment | gdc::record_last_fragment);
+
+			THEN("read() throws")
+			{
+				REQUIRE_THROWS_AS(r.read(buf, sizeof buf), gdc::circular_queue_error&);
+			}
+		}
+
+	}
+
+}
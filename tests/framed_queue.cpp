@@ -0,0 +1,194 @@
+//
+// Copyright (c) 2016 Dado Colussi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+#include <stdexcept>
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <unistd.h>
+
+#include "catch.hpp"
+
+#if USE_C_API
+#include "gdc_circular_queue_factory.h"
+#else
+#include "gdc_circular_queue_factory.hpp"
+#endif
+
+#include "gdc_framed_queue.hpp"
+
+
+namespace
+{
+	long page_size = ::sysconf(_SC_PAGESIZE);
+
+
+	struct point
+	{
+		point(std::int32_t xx, std::int32_t yy) : x(xx), y(yy) {}
+		std::int32_t x;
+		std::int32_t y;
+	};
+
+
+	struct series
+	{
+		series(std::uint32_t i) : id(i), count(0) {}
+		std::uint32_t id;
+		std::uint32_t count;
+	};
+}
+
+
+namespace gdc
+{
+	template<>
+	struct record_tag<point>
+	{
+		static const std::uint16_t value = 7;
+	};
+}
+
+
+SCENARIO("framed queue", "[framed]")
+{
+
+	typedef gdc::circular_queue_factory<char> F;
+	typedef typename F::value_type Q;
+	typedef gdc::framed_queue<Q> FQ;
+
+
+	GIVEN("an empty framed queue")
+	{
+
+		F f(10 * page_size);
+		FQ fq(f.get());
+
+
+		THEN("peek() returns nullptr")
+		{
+			REQUIRE(fq.peek() == nullptr);
+		}
+
+
+		WHEN("pushing records of different lengths")
+		{
+			std::string hello("Hello World!");
+			std::string bye("Bye!");
+			REQUIRE(fq.push(hello.c_str(), hello.length(), 1));
+			REQUIRE(fq.push(bye.c_str(), bye.length(), 2));
+
+			THEN("records are read back one at a time")
+			{
+				auto h = fq.peek();
+				REQUIRE(h != nullptr);
+				CHECK(h->size == hello.length());
+				CHECK(h->tag == 1);
+				auto p = static_cast<const char*>(FQ::payload(h));
+				CHECK(std::string(p, h->size) == hello);
+				fq.pop();
+
+				h = fq.peek();
+				REQUIRE(h != nullptr);
+				CHECK(h->tag == 2);
+				p = static_cast<const char*>(FQ::payload(h));
+				CHECK(std::string(p, h->size) == bye);
+				fq.pop();
+
+				CHECK(fq.empty());
+			}
+		}
+
+
+		WHEN("emplacing a record")
+		{
+			REQUIRE(fq.emplace<point>(3, 4));
+
+			THEN("the record is constructed in the queue with its tag")
+			{
+				auto h = fq.peek();
+				REQUIRE(h != nullptr);
+				CHECK(h->tag == 7);
+				CHECK(h->size == sizeof (point));
+				auto p = FQ::payload<point>(h);
+				CHECK(p->x == 3);
+				CHECK(p->y == 4);
+			}
+		}
+
+
+		WHEN("building a record with a trailing array")
+		{
+			auto b = fq.build<series, std::uint64_t>(16, 42);
+			REQUIRE(b);
+
+			for (std::uint32_t i = 0; i < 10; ++i)
+			{
+				b.trailing()[i] = i * i;
+				++b->count;
+			}
+
+			THEN("nothing is visible before commit()")
+			{
+				REQUIRE(fq.peek() == nullptr);
+			}
+
+			THEN("commit() publishes only the used elements")
+			{
+				b.commit(b->count);
+				auto h = fq.peek();
+				REQUIRE(h != nullptr);
+				CHECK(h->size == sizeof (series) + 10 * sizeof (std::uint64_t));
+				auto s = FQ::payload<series>(h);
+				CHECK(s->id == 42);
+				CHECK(s->count == 10);
+				auto values = gdc::trailing<std::uint64_t>(s);
+				CHECK(values[9] == 81);
+			}
+		}
+
+
+		WHEN("records wrap around the end of the queue")
+		{
+			std::string hello("Hello World!");
+
+			for (auto i = 0; i < 100000; ++i)
+			{
+				CAPTURE(i);
+				REQUIRE(fq.push(hello.c_str(), hello.length()));
+				auto h = fq.peek();
+				REQUIRE(h != nullptr);
+				REQUIRE(h->size == hello.length());
+				fq.pop();
+			}
+
+			THEN("the queue is empty")
+			{
+				REQUIRE(fq.empty());
+			}
+		}
+
+	}
+
+}
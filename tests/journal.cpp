@@ -0,0 +1,322 @@
+//
+// Copyright (c) 2016 Dado Colussi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+#include <string>
+#include <vector>
+#include <random>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <unistd.h>
+
+#include "catch.hpp"
+
+#if USE_C_API
+#include "gdc_circular_queue_factory.h"
+#else
+#include "gdc_circular_queue_factory.hpp"
+#endif
+
+#include "gdc_journal.hpp"
+
+
+namespace
+{
+	long page_size = ::sysconf(_SC_PAGESIZE);
+
+
+	std::string journal_path()
+	{
+		return "/tmp/gdcq.journal." + std::to_string(::getpid());
+	}
+
+
+	std::string text_record(int i)
+	{
+		return "2016-06-01T12:00:00.000 INFO order accepted id=" +
+			std::to_string(i) + " side=BUY qty=100 px=" + std::to_string(1000 + i % 10);
+	}
+}
+
+
+SCENARIO("LZ block codec", "[journal]")
+{
+
+	gdc::lz_codec codec;
+
+
+	GIVEN("repetitive input")
+	{
+		std::string in;
+		for (int i = 0; i < 1000; ++i)
+		{
+			in += text_record(i);
+		}
+
+		std::vector<char> z(codec.max_compressed_size(in.size()));
+		auto n = codec.compress(in.data(), in.size(), z.data(), z.size());
+
+		THEN("it compresses several-fold and decompresses back")
+		{
+			REQUIRE(n > 0);
+			CHECK(n * 3 < in.size());
+			std::vector<char> out(in.size());
+			REQUIRE(codec.decompress(z.data(), n, out.data(), out.size()) == in.size());
+			CHECK(std::string(out.data(), out.size()) == in);
+		}
+
+		THEN("decompressing into a short buffer fails")
+		{
+			std::vector<char> out(in.size() - 1);
+			auto error = gdc::block_codec::decompress_error;
+			CHECK(codec.decompress(z.data(), n, out.data(), out.size()) == error);
+		}
+
+		THEN("the compressed size bounds the decompressed size")
+		{
+			CHECK(codec.max_decompressed_size(n) >= in.size());
+		}
+	}
+
+
+	GIVEN("empty input")
+	{
+		std::vector<char> z(codec.max_compressed_size(0));
+		auto n = codec.compress(nullptr, 0, z.data(), z.size());
+
+		THEN("it decompresses to nothing, which is not an error")
+		{
+			REQUIRE(n > 0);
+			char out[1];
+			CHECK(codec.decompress(z.data(), n, out, 0) == 0);
+		}
+	}
+
+
+	GIVEN("corrupt input")
+	{
+		// A match before any output.
+		const unsigned char z[] = { 0x01, 0x01, 0x00 };
+
+		THEN("decompressing fails")
+		{
+			char out[64];
+			auto error = gdc::block_codec::decompress_error;
+			CHECK(codec.decompress(z, sizeof z, out, sizeof out) == error);
+		}
+	}
+
+
+	GIVEN("random input")
+	{
+		std::mt19937 rng(1);
+		std::vector<char> in(10000);
+		for (auto& c : in)
+		{
+			c = static_cast<char>(rng());
+		}
+
+		std::vector<char> z(codec.max_compressed_size(in.size()));
+		auto n = codec.compress(in.data(), in.size(), z.data(), z.size());
+
+		THEN("it round trips within the bound")
+		{
+			REQUIRE(n > 0);
+			REQUIRE(n <= z.size());
+			std::vector<char> out(in.size());
+			REQUIRE(codec.decompress(z.data(), n, out.data(), out.size()) == in.size());
+			CHECK(out == in);
+		}
+	}
+
+}
+
+
+SCENARIO("journal", "[journal]")
+{
+
+	typedef gdc::circular_queue_factory<char> F;
+	typedef typename F::value_type Q;
+	typedef gdc::framed_queue<Q> FQ;
+
+
+	GIVEN("a journal writer draining a framed queue")
+	{
+
+		F f(16 * page_size);
+		FQ fq(f.get());
+		auto path = journal_path();
+		const int n = 10000;
+
+
+		WHEN("text records are written to the journal")
+		{
+			std::size_t bytes_in = 0;
+			std::size_t bytes_out = 0;
+
+			{
+				gdc::journal_writer<Q> w(fq, path);
+
+				for (int i = 0; i < n; ++i)
+				{
+					auto s = text_record(i);
+					if (!fq.push(s.data(), s.size(), 1))
+					{
+						w.drain();
+						REQUIRE(fq.push(s.data(), s.size(), 1));
+					}
+				}
+
+				w.drain();
+				w.flush();
+				CHECK(w.records() == n);
+				bytes_in = w.bytes_in();
+				bytes_out = w.bytes_out();
+			}
+
+			THEN("the file is several times smaller than the records")
+			{
+				CHECK(bytes_out * 3 < bytes_in);
+			}
+
+			THEN("the reader returns every record in order")
+			{
+				gdc::journal_reader r(path);
+
+				for (int i = 0; i < n; ++i)
+				{
+					CAPTURE(i);
+					auto h = r.next();
+					REQUIRE(h != nullptr);
+					CHECK(h->tag == 1);
+					auto p = static_cast<const char*>(FQ::payload(h));
+					REQUIRE(std::string(p, h->size) == text_record(i));
+				}
+
+				CHECK(r.next() == nullptr);
+			}
+
+			std::remove(path.c_str());
+		}
+
+	}
+
+
+	GIVEN("a journal whose block header claims more bytes than the file has")
+	{
+
+		auto path = journal_path();
+		gdc::journal_block_header h;
+		h.magic = gdc::detail::journal_magic;
+		h.codec = gdc::null_codec::codec_id;
+		h.raw_size = 0xfffffff0;
+		h.size = 0xfffffff0;
+		h.records = 1;
+		h.reserved = 0;
+
+		auto file = std::fopen(path.c_str(), "wb");
+		REQUIRE(file != nullptr);
+		std::fwrite(&h, sizeof h, 1, file);
+		std::fclose(file);
+
+		THEN("the reader throws gdc::circular_queue_error")
+		{
+			gdc::journal_reader r(path);
+			REQUIRE_THROWS_AS(r.next(), gdc::circular_queue_error&);
+		}
+
+		std::remove(path.c_str());
+
+	}
+
+
+	GIVEN("a journal with an empty block before a record")
+	{
+
+		auto path = journal_path();
+		gdc::record_header rh;
+		std::memset(&rh, 0, sizeof rh);
+		rh.tag = 5;
+		gdc::journal_block_header h;
+		h.magic = gdc::detail::journal_magic;
+		h.codec = gdc::null_codec::codec_id;
+		h.raw_size = 0;
+		h.size = 0;
+		h.records = 0;
+		h.reserved = 0;
+
+		auto file = std::fopen(path.c_str(), "wb");
+		REQUIRE(file != nullptr);
+		std::fwrite(&h, sizeof h, 1, file);
+		h.raw_size = sizeof rh;
+		h.size = sizeof rh;
+		h.records = 1;
+		std::fwrite(&h, sizeof h, 1, file);
+		std::fwrite(&rh, sizeof rh, 1, file);
+		std::fclose(file);
+
+		THEN("the reader skips the empty block")
+		{
+			gdc::journal_reader r(path);
+			auto p = r.next();
+			REQUIRE(p != nullptr);
+			CHECK(p->tag == 5);
+			CHECK(r.next() == nullptr);
+		}
+
+		std::remove(path.c_str());
+
+	}
+
+
+	GIVEN("a journal whose block ends inside a record header")
+	{
+
+		auto path = journal_path();
+		char raw[sizeof (gdc::record_header) / 2] = {};
+		gdc::journal_block_header h;
+		h.magic = gdc::detail::journal_magic;
+		h.codec = gdc::null_codec::codec_id;
+		h.raw_size = sizeof raw;
+		h.size = sizeof raw;
+		h.records = 1;
+		h.reserved = 0;
+
+		auto file = std::fopen(path.c_str(), "wb");
+		REQUIRE(file != nullptr);
+		std::fwrite(&h, sizeof h, 1, file);
+		std::fwrite(raw, sizeof raw, 1, file);
+		std::fclose(file);
+
+		THEN("the reader throws gdc::circular_queue_error")
+		{
+			gdc::journal_reader r(path);
+			REQUIRE_THROWS_AS(r.next(), gdc::circular_queue_error&);
+		}
+
+		std::remove(path.c_str());
+
+	}
+
+}
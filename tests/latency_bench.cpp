@@ -0,0 +1,158 @@
+//
+// Copyright (c) 2016 Dado Colussi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <cstdint>
+#include <cstdlib>
+
+#include "gdc_circular_queue_factory.hpp"
+#include "gdc_load_generator.hpp"
+#include "gdc_load_latency.hpp"
+
+
+// Open-loop latency under load. Sends are scheduled at a fixed rate and
+// latency runs from the scheduled send time to consumer receipt, so time
+// a record waits behind a full queue or a slow consumer is counted
+// instead of silently delaying the next send (coordinated omission).
+// Offered load is swept as a fraction of the saturation throughput,
+// measured first, for each queue capacity. Records the producer could not
+// send by the end of a step are reported as dropped, and max lag is how
+// far the producer fell behind its schedule.
+//
+// Usage: latency_bench [payload bytes] [ms per step] [capacity...]
+
+
+namespace
+{
+
+	typedef gdc::circular_queue_factory<char> F;
+	typedef typename F::value_type Q;
+	typedef gdc::framed_queue<Q> FQ;
+
+
+	const double load_steps[] = { 0.1, 0.25, 0.5, 0.7, 0.8, 0.9, 0.95, 1.0, 1.1 };
+
+
+	struct step_result
+	{
+		double offered;
+		double achieved;
+		std::uint64_t dropped;
+		std::uint64_t max_lag_ns;
+		std::vector<std::uint64_t> latencies;
+	};
+
+
+	// Offered rate 0 sends flat out.
+	step_result run_step(std::size_t capacity, std::size_t size, double rate, std::uint64_t duration_ns)
+	{
+		F f(capacity);
+		auto& q = f.get();
+		FQ producer(q);
+		gdc::load_options o;
+		o.sizes = gdc::size_distribution::fixed(size);
+		o.records_per_second = rate;
+		o.duration_ns = duration_ns;
+		gdc::load_generator<Q> generator(producer, o);
+		step_result result;
+		result.offered = rate;
+		result.latencies.reserve(rate > 0 ? static_cast<std::size_t>(rate * duration_ns / 1e9 * 1.1) : 1 << 20);
+		std::atomic<bool> done(false);
+		std::thread consumer(gdc::drain_load<Q>, std::ref(q), std::cref(done), std::ref(result.latencies));
+		auto r = generator.run();
+		done.store(true, std::memory_order_release);
+		consumer.join();
+		result.achieved = r.records_per_second();
+		result.dropped = r.dropped;
+		result.max_lag_ns = r.max_lag_ns;
+		return result;
+	}
+
+}
+
+
+int
+main(int argc, char* argv[])
+{
+	std::size_t size = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 64;
+	std::uint64_t step_ns = (argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 200) * 1000000;
+	std::vector<std::size_t> capacities;
+
+	for (int i = 3; i < argc; ++i)
+	{
+		capacities.push_back(std::strtoul(argv[i], nullptr, 10));
+	}
+
+	if (capacities.empty())
+	{
+		capacities.push_back(64 << 10);
+		capacities.push_back(1 << 20);
+	}
+
+	try
+	{
+		std::cout << "payload " << size << " B, " << step_ns / 1000000 << " ms per step, latency in us" << std::endl;
+
+		for (auto capacity : capacities)
+		{
+			auto saturation = run_step(capacity, size, 0, step_ns).achieved;
+			std::cout << std::endl
+				<< "capacity " << capacity << " B, saturation " << std::fixed << std::setprecision(0)
+				<< saturation << " records/s" << std::endl
+				<< "  load    offered   achieved      p50      p90      p99    p99.9      max  dropped  max lag" << std::endl;
+
+			for (auto fraction : load_steps)
+			{
+				auto s = run_step(capacity, size, fraction * saturation, step_ns);
+				auto& v = s.latencies;
+				std::cout << std::fixed
+					<< std::setw(6) << std::setprecision(2) << fraction
+					<< std::setprecision(0)
+					<< std::setw(11) << s.offered
+					<< std::setw(11) << s.achieved
+					<< std::setprecision(1)
+					<< std::setw(9) << gdc::latency_percentile(v, 0.5) / 1e3
+					<< std::setw(9) << gdc::latency_percentile(v, 0.9) / 1e3
+					<< std::setw(9) << gdc::latency_percentile(v, 0.99) / 1e3
+					<< std::setw(9) << gdc::latency_percentile(v, 0.999) / 1e3
+					<< std::setw(9) << gdc::latency_percentile(v, 1) / 1e3
+					<< std::setw(9) << s.dropped
+					<< std::setw(9) << s.max_lag_ns / 1e3 << std::endl;
+			}
+		}
+	}
+	catch (const std::exception& ex)
+	{
+		std::cerr << ex.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
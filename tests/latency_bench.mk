@@ -0,0 +1,5 @@
+TARGET := latency_bench
+TGT_INCDIRS := ../src
+TGT_DEFS :=
+TGT_CXXFLAGS := -O2
+SOURCES := latency_bench.cpp
@@ -0,0 +1,210 @@
+//
+// Copyright (c) 2016 Dado Colussi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+#include <thread>
+#include <atomic>
+#include <cstdint>
+
+#include "catch.hpp"
+
+#if USE_C_API
+#include "gdc_circular_queue_factory.h"
+#else
+#include "gdc_circular_queue_factory.hpp"
+#endif
+
+#include "gdc_latest_value.hpp"
+
+
+namespace
+{
+	std::string name("/gdcq.latest_value_tests");
+
+
+	struct book
+	{
+		std::uint64_t version;
+		std::uint64_t levels[200];
+	};
+
+
+	void fill(book& b, std::uint64_t version)
+	{
+		b.version = version;
+
+		for (auto& l : b.levels)
+		{
+			l = version;
+		}
+	}
+}
+
+
+SCENARIO("latest value triple buffer", "[latest_value]")
+{
+
+	typedef gdc::circular_queue_factory<char> F;
+	typedef typename F::value_type Q;
+	typedef gdc::latest_value<book, Q> L;
+
+	F::delete_shared(name);
+
+
+	GIVEN("a private latest value")
+	{
+
+		F f(L::capacity(), true, L::init);
+		L producer(f.get());
+		L consumer(f.get());
+
+
+		THEN("nothing is read before the first publish")
+		{
+			CHECK_FALSE(consumer.fresh());
+			CHECK(consumer.read() == nullptr);
+		}
+
+
+		WHEN("publishing several snapshots before reading")
+		{
+			for (std::uint64_t i = 1; i <= 3; ++i)
+			{
+				fill(producer.next(), i);
+				producer.publish();
+			}
+
+			THEN("the reader sees only the newest one")
+			{
+				CHECK(consumer.fresh());
+				auto b = consumer.read();
+				REQUIRE(b != nullptr);
+				CHECK(b->version == 3);
+				CHECK(b->levels[199] == 3);
+				CHECK_FALSE(consumer.fresh());
+				CHECK(consumer.read()->version == 3);
+			}
+		}
+
+
+		WHEN("publishing between reads")
+		{
+			book b;
+			fill(b, 1);
+			producer.publish(b);
+			auto r1 = consumer.read();
+			REQUIRE(r1->version == 1);
+			fill(b, 2);
+			producer.publish(b);
+
+			THEN("the previous snapshot stays intact until the next read")
+			{
+				CHECK(r1->version == 1);
+				CHECK(r1->levels[0] == 1);
+				CHECK(consumer.read()->version == 2);
+			}
+		}
+
+	}
+
+
+	GIVEN("a shared latest value mapped by name")
+	{
+
+		F f(name, L::capacity(), true, L::init);
+		L producer(f.get());
+		F g(name);
+		L consumer(g.get());
+
+		book b;
+		fill(b, 7);
+		producer.publish(b);
+
+		THEN("the reader in the other mapping sees the snapshot")
+		{
+			auto r = consumer.read();
+			REQUIRE(r != nullptr);
+			CHECK(r->version == 7);
+		}
+
+	}
+
+
+	GIVEN("a producer publishing concurrently")
+	{
+
+		F f(L::capacity(), true, L::init);
+		auto& q = f.get();
+		const std::uint64_t n = 20000;
+		std::atomic<bool> done(false);
+
+		std::thread writer([&q, &done, n]()
+		{
+			L producer(q);
+
+			for (std::uint64_t i = 1; i <= n; ++i)
+			{
+				fill(producer.next(), i);
+				producer.publish();
+
+				if (i % 64 == 0)
+				{
+					std::this_thread::yield();
+				}
+			}
+
+			done.store(true);
+		});
+
+		L consumer(q);
+		bool consistent = true;
+		bool monotonic = true;
+		std::uint64_t last = 0;
+
+		while (!done.load())
+		{
+			auto r = consumer.read();
+
+			if (r != nullptr)
+			{
+				consistent = consistent && r->levels[0] == r->version;
+				consistent = consistent && r->levels[199] == r->version;
+				monotonic = monotonic && r->version >= last;
+				last = r->version;
+			}
+
+			std::this_thread::yield();
+		}
+
+		writer.join();
+
+		THEN("every snapshot read is complete and newer than the last")
+		{
+			CHECK(consistent);
+			CHECK(monotonic);
+			CHECK(consumer.read()->version == n);
+		}
+
+	}
+
+}
@@ -0,0 +1,219 @@
+//
+// Copyright (c) 2016 Dado Colussi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+#include <thread>
+#include <chrono>
+#include <iostream>
+#include <cstdint>
+#include <cstdlib>
+
+#include "gdc_circular_queue_factory.hpp"
+#include "gdc_topology.hpp"
+#include "gdc_thread.hpp"
+
+
+// Measures throughput and one-way latency of a queue with the control
+// block padding this binary was built with. Built once per layout
+// profile: layout_bench_64, layout_bench_128 and layout_bench_page.
+//
+// Usage: layout_bench_<profile> [messages] [round trips]
+
+
+namespace
+{
+
+	typedef gdc::circular_queue_factory<std::uint64_t> F;
+	typedef typename F::value_type Q;
+	typedef std::chrono::steady_clock clock;
+
+
+	const std::size_t capacity = 1024 * 1024;
+
+
+	// Picks two CPUs on different cores, or -1 if there aren't any.
+	void pick_cpus(int& producer, int& consumer)
+	{
+		producer = -1;
+		consumer = -1;
+		auto cpus = gdc::read_cpu_topology();
+
+		for (auto& a : cpus)
+		{
+			for (auto& b : cpus)
+			{
+				auto r = gdc::relation(a, b);
+
+				if (r != gdc::cpu_relation::same_cpu && r != gdc::cpu_relation::smt_sibling)
+				{
+					producer = a.cpu;
+					consumer = b.cpu;
+					return;
+				}
+			}
+		}
+	}
+
+
+	void pin(int cpu)
+	{
+		if (cpu >= 0)
+		{
+			gdc::pin_current_thread(cpu);
+		}
+	}
+
+
+	double throughput(std::uint64_t n, int producer_cpu, int consumer_cpu)
+	{
+		F f(capacity);
+		auto& q = f.get();
+
+		std::thread consumer([&q, n, consumer_cpu]()
+		{
+			pin(consumer_cpu);
+
+			for (std::uint64_t i = 0; i < n; )
+			{
+				auto p = q.peek();
+
+				if (p == nullptr)
+				{
+					std::this_thread::yield();
+					continue;
+				}
+
+				q.pop(sizeof *p);
+				++i;
+			}
+		});
+
+		pin(producer_cpu);
+		auto t0 = clock::now();
+
+		for (std::uint64_t i = 0; i < n; )
+		{
+			if (q.push(i))
+			{
+				++i;
+			}
+			else
+			{
+				std::this_thread::yield();
+			}
+		}
+
+		consumer.join();
+		std::chrono::duration<double, std::nano> d = clock::now() - t0;
+		return d.count() / n;
+	}
+
+
+	double latency(std::uint64_t round_trips, int producer_cpu, int consumer_cpu)
+	{
+		F f1(capacity);
+		F f2(capacity);
+		auto& ping = f1.get();
+		auto& pong = f2.get();
+
+		std::thread echo([&ping, &pong, round_trips, consumer_cpu]()
+		{
+			pin(consumer_cpu);
+
+			for (std::uint64_t i = 0; i < round_trips; )
+			{
+				auto p = ping.peek();
+
+				if (p != nullptr)
+				{
+					auto v = *p;
+					ping.pop(sizeof v);
+					pong.push(v);
+					++i;
+				}
+			}
+		});
+
+		pin(producer_cpu);
+		auto t0 = clock::now();
+
+		for (std::uint64_t i = 0; i < round_trips; ++i)
+		{
+			ping.push(i);
+
+			while (pong.peek() == nullptr)
+			{
+			}
+
+			pong.pop(sizeof (std::uint64_t));
+		}
+
+		echo.join();
+		std::chrono::duration<double, std::nano> d = clock::now() - t0;
+		return d.count() / round_trips / 2;
+	}
+
+}
+
+
+int
+main(int argc, char* argv[])
+{
+	std::uint64_t messages = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 10000000;
+	std::uint64_t round_trips = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 1000000;
+
+	try
+	{
+		int producer_cpu;
+		int consumer_cpu;
+		pick_cpus(producer_cpu, consumer_cpu);
+
+		std::cout
+			<< "padding " << GDC_CONTROL_BLOCK_PADDING
+			<< " bytes, detected cache line " << gdc::detected_cache_line_size()
+			<< " bytes" << std::endl;
+
+		if (producer_cpu < 0)
+		{
+			std::cout << "No two separate cores, running unpinned without the latency test." << std::endl;
+		}
+		else
+		{
+			std::cout << "producer cpu " << producer_cpu << ", consumer cpu " << consumer_cpu << std::endl;
+		}
+
+		std::cout << "throughput: " << throughput(messages, producer_cpu, consumer_cpu) << " ns/message" << std::endl;
+
+		if (producer_cpu >= 0)
+		{
+			std::cout << "latency   : " << latency(round_trips, producer_cpu, consumer_cpu) << " ns one way" << std::endl;
+		}
+	}
+	catch (const std::exception& ex)
+	{
+		std::cerr << ex.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,5 @@
+TARGET := layout_bench_64
+TGT_INCDIRS := ../src
+TGT_DEFS := GDC_CONTROL_BLOCK_PADDING=64
+TGT_CXXFLAGS := -O2
+SOURCES := layout_bench.cpp
@@ -0,0 +1,5 @@
+TARGET := layout_bench_page
+TGT_INCDIRS := ../src
+TGT_DEFS := GDC_CONTROL_BLOCK_PADDING=4096
+TGT_CXXFLAGS := -O2
+SOURCES := layout_bench.cpp
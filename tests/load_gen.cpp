@@ -0,0 +1,227 @@
+//
+// Copyright (c) 2016 Dado Colussi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+
+#include <thread>
+#include <atomic>
+#include <string>
+#include <iostream>
+#include <iomanip>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#include "gdc_circular_queue_factory.hpp"
+#include "gdc_load_generator.hpp"
+
+
+// Drives a private queue with synthetic load and a draining consumer, and
+// reports the achieved rate and full queue events.
+//
+// Usage: load_gen [options]
+//   --size N            fixed payload size (default 16)
+//   --uniform LO:HI     uniform payload sizes
+//   --sizes FILE        empirical sizes, lines of "size [weight]"
+//   --rate N            records per second, 0 for flat out (default 0)
+//   --burst N           records per scheduled instant (default 1)
+//   --on-ms N --off-ms N  alternating send and idle periods
+//   --records N         stop after N records
+//   --seconds N         stop after N seconds (default 1)
+//   --capacity N        queue capacity in bytes (default 1 MiB)
+//   --drop              drop records meeting a full queue instead of waiting
+
+
+namespace
+{
+
+	typedef gdc::circular_queue_factory<char> F;
+	typedef typename F::value_type Q;
+	typedef gdc::framed_queue<Q> FQ;
+
+
+	struct drain_result
+	{
+		std::uint64_t records;
+		std::uint64_t gaps;
+	};
+
+
+	void drain(Q& q, const std::atomic<bool>& done, drain_result& result)
+	{
+		FQ fq(q);
+		std::uint64_t expected = 0;
+
+		for (;;)
+		{
+			auto h = fq.peek();
+
+			if (h == nullptr)
+			{
+				if (done.load(std::memory_order_acquire) && fq.empty())
+				{
+					return;
+				}
+
+				std::this_thread::yield();
+				continue;
+			}
+
+			auto r = FQ::payload<gdc::load_record>(h);
+
+			if (r->sequence != expected)
+			{
+				++result.gaps;
+			}
+
+			expected = r->sequence + 1;
+			++result.records;
+			fq.pop();
+		}
+	}
+
+
+	void usage()
+	{
+		std::cerr
+			<< "Usage: load_gen [--size N | --uniform LO:HI | --sizes FILE] [--rate N] [--burst N]" << std::endl
+			<< "                [--on-ms N --off-ms N] [--records N] [--seconds N] [--capacity N] [--drop]" << std::endl;
+	}
+
+}
+
+
+int
+main(int argc, char* argv[])
+{
+	gdc::load_options o;
+	o.duration_ns = 1000000000;
+	std::size_t capacity = 1 << 20;
+
+	try
+	{
+		for (int i = 1; i < argc; ++i)
+		{
+			std::string a = argv[i];
+
+			if (a == "--drop")
+			{
+				o.drop_when_full = true;
+				continue;
+			}
+
+			if (i + 1 == argc)
+			{
+				usage();
+				return EXIT_FAILURE;
+			}
+
+			std::string v = argv[++i];
+
+			if (a == "--size")
+			{
+				o.sizes = gdc::size_distribution::fixed(std::stoul(v));
+			}
+			else if (a == "--uniform")
+			{
+				auto colon = v.find(':');
+				o.sizes = gdc::size_distribution::uniform(std::stoul(v), std::stoul(v.substr(colon + 1)));
+			}
+			else if (a == "--sizes")
+			{
+				o.sizes = gdc::size_distribution::from_file(v);
+			}
+			else if (a == "--rate")
+			{
+				o.records_per_second = std::stod(v);
+			}
+			else if (a == "--burst")
+			{
+				o.burst_records = std::stoul(v);
+			}
+			else if (a == "--on-ms")
+			{
+				o.on_ns = std::stoull(v) * 1000000;
+			}
+			else if (a == "--off-ms")
+			{
+				o.off_ns = std::stoull(v) * 1000000;
+			}
+			else if (a == "--records")
+			{
+				o.records = std::stoull(v);
+				o.duration_ns = 0;
+			}
+			else if (a == "--seconds")
+			{
+				o.duration_ns = static_cast<std::uint64_t>(std::stod(v) * 1e9);
+			}
+			else if (a == "--capacity")
+			{
+				capacity = std::stoul(v);
+			}
+			else
+			{
+				usage();
+				return EXIT_FAILURE;
+			}
+		}
+
+		F f(capacity);
+		auto& q = f.get();
+		FQ producer(q);
+		gdc::load_generator<Q> generator(producer, o);
+		std::atomic<bool> done(false);
+		drain_result drained;
+		std::memset(&drained, 0, sizeof drained);
+		std::thread consumer(drain, std::ref(q), std::cref(done), std::ref(drained));
+		auto r = generator.run();
+		done.store(true, std::memory_order_release);
+		consumer.join();
+
+		std::cout << std::fixed << std::setprecision(0)
+			<< "mean size (B)      " << o.sizes.mean() << std::endl
+			<< "target (records/s) " << o.records_per_second << std::endl
+			<< "sent (records/s)   " << r.records_per_second() << std::endl
+			<< "sent (MB/s)        " << r.bytes_per_second() / 1e6 << std::endl
+			<< "records            " << r.records << std::endl
+			<< "full events        " << r.full_events << std::endl
+			<< "dropped            " << r.dropped << std::endl
+			<< "max lag (us)       " << r.max_lag_ns / 1e3 << std::endl
+			<< "received           " << drained.records << std::endl
+			<< "sequence gaps      " << drained.gaps << std::endl;
+
+		if (drained.records != r.records)
+		{
+			std::cerr << "Consumer lost records" << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+	catch (const std::exception& ex)
+	{
+		std::cerr << ex.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,5 @@
+TARGET := load_gen
+TGT_INCDIRS := ../src
+TGT_DEFS :=
+TGT_CXXFLAGS := -O2
+SOURCES := load_gen.cpp
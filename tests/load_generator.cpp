@@ -0,0 +1,364 @@
+//
+// Copyright (c) 2016 Dado Colussi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <random>
+#include <fstream>
+#include <cstdio>
+#include <cstdint>
+#include <unistd.h>
+
+#include "catch.hpp"
+
+#if USE_C_API
+#include "gdc_circular_queue_factory.h"
+#else
+#include "gdc_circular_queue_factory.hpp"
+#endif
+
+#include "gdc_load_generator.hpp"
+#include "gdc_load_latency.hpp"
+
+
+namespace
+{
+	long page_size = ::sysconf(_SC_PAGESIZE);
+}
+
+
+SCENARIO("size distributions", "[load_generator]")
+{
+
+	std::mt19937_64 rng(7);
+
+
+	GIVEN("a uniform distribution")
+	{
+
+		auto d = gdc::size_distribution::uniform(10, 20);
+
+		THEN("samples stay in range")
+		{
+			for (int i = 0; i < 1000; ++i)
+			{
+				auto n = d(rng);
+				REQUIRE(n >= 10);
+				REQUIRE(n <= 20);
+			}
+
+			CHECK(d.max() == 20);
+			CHECK(d.mean() == 15);
+		}
+
+	}
+
+
+	GIVEN("an empirical distribution read from a file")
+	{
+
+		char path[] = "/tmp/gdc_sizesXXXXXX";
+		int fd = ::mkstemp(path);
+		REQUIRE(fd >= 0);
+		::close(fd);
+
+		{
+			std::ofstream out(path);
+			out << "# size weight" << std::endl;
+			out << "64 3" << std::endl;
+			out << std::endl;
+			out << "4096 1" << std::endl;
+		}
+
+		auto d = gdc::size_distribution::from_file(path);
+		std::remove(path);
+
+		THEN("sizes follow the weights")
+		{
+			int small = 0;
+			const int n = 4000;
+
+			for (int i = 0; i < n; ++i)
+			{
+				auto s = d(rng);
+				REQUIRE((s == 64 || s == 4096));
+				small += s == 64;
+			}
+
+			CHECK(small > n * 0.7);
+			CHECK(small < n * 0.8);
+			CHECK(d.max() == 4096);
+			CHECK(d.mean() == Approx(1072));
+		}
+
+	}
+
+
+	GIVEN("a malformed size file")
+	{
+
+		char path[] = "/tmp/gdc_sizesXXXXXX";
+		int fd = ::mkstemp(path);
+		REQUIRE(fd >= 0);
+		::close(fd);
+
+		{
+			std::ofstream out(path);
+			out << "64x" << std::endl;
+		}
+
+		THEN("reading it throws")
+		{
+			CHECK_THROWS_AS(gdc::size_distribution::from_file(path), gdc::circular_queue_error&);
+			std::remove(path);
+		}
+
+	}
+
+}
+
+
+SCENARIO("load generation", "[load_generator]")
+{
+
+	typedef gdc::circular_queue_factory<char> F;
+	typedef typename F::value_type Q;
+	typedef gdc::framed_queue<Q> FQ;
+
+	F f(4 * page_size);
+	auto& q = f.get();
+	FQ producer(q);
+	FQ consumer(q);
+
+
+	GIVEN("a record limit and a queue large enough")
+	{
+
+		gdc::load_options o;
+		o.sizes = gdc::size_distribution::uniform(1, 100);
+		o.records = 20;
+		o.tag = 3;
+		gdc::load_generator<Q> g(producer, o);
+		auto r = g.run();
+
+		THEN("all records arrive in order with their sizes")
+		{
+			CHECK(r.records == 20);
+			CHECK(r.full_events == 0);
+			std::uint64_t bytes = 0;
+
+			for (std::uint64_t i = 0; i < 20; ++i)
+			{
+				auto h = consumer.peek();
+				REQUIRE(h != nullptr);
+				CHECK(h->tag == 3);
+				CHECK(h->size >= sizeof (gdc::load_record));
+				CHECK(FQ::payload<gdc::load_record>(h)->sequence == i);
+				bytes += h->size;
+				consumer.pop();
+			}
+
+			CHECK(consumer.peek() == nullptr);
+			CHECK(r.bytes == bytes);
+		}
+
+	}
+
+
+	GIVEN("more load than the queue holds and drops enabled")
+	{
+
+		gdc::load_options o;
+		o.sizes = gdc::size_distribution::fixed(1000);
+		o.records = 100;
+		o.drop_when_full = true;
+		gdc::load_generator<Q> g(producer, o);
+		auto r = g.run();
+
+		THEN("records meeting a full queue are dropped and counted")
+		{
+			CHECK(r.records > 0);
+			CHECK(r.records + r.dropped == 100);
+			CHECK(r.dropped == r.full_events);
+			CHECK(r.records * FQ::footprint(1000) < q.capacity());
+		}
+
+	}
+
+
+	GIVEN("a time limit, no rate and no consumer")
+	{
+
+		gdc::load_options o;
+		o.sizes = gdc::size_distribution::fixed(1000);
+		o.duration_ns = 20000000;
+		gdc::load_generator<Q> g(producer, o);
+		auto r = g.run();
+
+		THEN("the producer fills the queue and gives up at the deadline")
+		{
+			CHECK(r.records > 0);
+			CHECK(r.full_events == 1);
+			CHECK(r.dropped == 1);
+			CHECK(r.elapsed_ns >= 20000000);
+			CHECK(r.elapsed_ns < 1000000000);
+		}
+
+	}
+
+
+	GIVEN("a time limit, a target rate and no consumer")
+	{
+
+		gdc::load_options o;
+		o.sizes = gdc::size_distribution::fixed(1000);
+		o.records_per_second = 100000;
+		o.duration_ns = 20000000;
+		gdc::load_generator<Q> g(producer, o);
+		auto r = g.run();
+
+		THEN("records still scheduled at the deadline are counted as dropped")
+		{
+			CHECK(r.records > 0);
+			CHECK(r.records * FQ::footprint(1000) < q.capacity());
+			CHECK(r.records + r.dropped >= 1999);
+			CHECK(r.records + r.dropped <= 2001);
+		}
+
+	}
+
+
+	GIVEN("a target rate in bursts")
+	{
+
+		gdc::load_options o;
+		o.records_per_second = 20000;
+		o.burst_records = 10;
+		o.records = 100;
+		gdc::load_generator<Q> g(producer, o);
+		std::uint64_t intended[100];
+
+		// Drain while generating.
+		std::thread t([&]()
+		{
+			for (int i = 0; i < 100; )
+			{
+				auto h = consumer.peek();
+
+				if (h == nullptr)
+				{
+					std::this_thread::yield();
+					continue;
+				}
+
+				intended[i++] = FQ::payload<gdc::load_record>(h)->intended_ns;
+				consumer.pop();
+			}
+		});
+
+		auto r = g.run();
+		t.join();
+
+		THEN("bursts share a scheduled instant and are spaced by the rate")
+		{
+			CHECK(r.records == 100);
+			CHECK(intended[9] == intended[0]);
+			CHECK(intended[10] - intended[0] == 500000);
+			CHECK(intended[99] - intended[0] == 9 * 500000);
+			CHECK(r.elapsed_ns >= 9 * 500000);
+		}
+
+	}
+
+
+	GIVEN("a record larger than the queue")
+	{
+
+		gdc::load_options o;
+		o.sizes = gdc::size_distribution::fixed(q.capacity());
+
+		THEN("construction throws")
+		{
+			CHECK_THROWS_AS(gdc::load_generator<Q>(producer, o), gdc::circular_queue_error&);
+		}
+
+	}
+
+}
+
+
+SCENARIO("load latency", "[load_generator]")
+{
+
+	typedef gdc::circular_queue_factory<char> F;
+	typedef typename F::value_type Q;
+	typedef gdc::framed_queue<Q> FQ;
+
+
+	GIVEN("generated records and a finished producer")
+	{
+
+		F f(4 * page_size);
+		auto& q = f.get();
+		FQ producer(q);
+		gdc::load_options o;
+		o.records = 10;
+		gdc::load_generator<Q>(producer, o).run();
+		std::atomic<bool> done(true);
+		std::vector<std::uint64_t> latencies;
+		gdc::drain_load(q, done, latencies);
+
+		THEN("drain_load() takes a latency for every record and empties the queue")
+		{
+			CHECK(latencies.size() == 10);
+			CHECK(FQ(q).empty());
+		}
+
+	}
+
+
+	GIVEN("latencies")
+	{
+
+		std::vector<std::uint64_t> v = { 50, 10, 40, 20, 30 };
+
+		THEN("latency_percentile() picks the nearest rank below")
+		{
+			CHECK(gdc::latency_percentile(v, 0) == 10);
+			CHECK(gdc::latency_percentile(v, 0.5) == 30);
+			CHECK(gdc::latency_percentile(v, 0.9) == 40);
+			CHECK(gdc::latency_percentile(v, 1) == 50);
+		}
+
+		THEN("an empty sample gives 0")
+		{
+			std::vector<std::uint64_t> empty;
+			CHECK(gdc::latency_percentile(empty, 0.99) == 0);
+		}
+
+	}
+
+}
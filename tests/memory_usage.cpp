@@ -0,0 +1,135 @@
+//
+// Copyright (c) 2016 Dado Colussi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+
+#include <cstring>
+#include <unistd.h>
+
+#include "catch.hpp"
+
+#if USE_C_API
+#include "gdc_circular_queue_factory.h"
+#else
+#include "gdc_circular_queue_factory.hpp"
+#endif
+
+#include "gdc_memory_usage.hpp"
+
+
+namespace
+{
+	std::size_t page_size = ::sysconf(_SC_PAGESIZE);
+	std::string name("/gdcq.memory_usage_tests");
+}
+
+
+SCENARIO("queue memory usage", "[memory_usage]")
+{
+
+	typedef gdc::circular_queue_factory<char> F;
+
+
+	GIVEN("a private queue before and after get()")
+	{
+
+		auto before = gdc::process_memory_usage();
+		F f(16 * page_size);
+		auto& q = f.get();
+		auto u = gdc::memory_usage(gdc::factory_region(f));
+
+		THEN("the layout is reported")
+		{
+			CHECK(u.queues == 1);
+			CHECK(u.control == static_cast<std::size_t>(q.data() - reinterpret_cast<const char*>(&q)));
+			CHECK(u.data == 16 * page_size);
+			CHECK(u.mapped == u.control + 2 * u.data);
+		}
+
+		THEN("only touched pages are resident")
+		{
+			CHECK(u.control_resident >= page_size);
+			CHECK(u.data_resident == 0);
+			auto p = q.alloc(4 * page_size);
+			REQUIRE(p != nullptr);
+			std::memset(p, 1, 4 * page_size);
+			q.commit(4 * page_size);
+			u = gdc::memory_usage(gdc::factory_region(f));
+			CHECK(u.data_resident == 4 * page_size);
+			CHECK(u.resident() == u.control_resident + u.data_resident);
+			CHECK(u.shm_allocated <= u.control + u.data);
+		}
+
+		THEN("the process aggregate includes the queue once tracked")
+		{
+			CHECK(gdc::process_memory_usage().queues == before.queues);
+			auto registration = gdc::queue_registry::track(f);
+			auto after = gdc::process_memory_usage();
+			CHECK(after.queues == before.queues + 1);
+			CHECK(after.mapped == before.mapped + u.mapped);
+		}
+
+	}
+
+
+	GIVEN("a shared queue and a second mapping of it")
+	{
+
+		F::delete_shared(name);
+		F f(name, 4 * page_size);
+		auto& q = f.get();
+		auto p = q.alloc(page_size);
+		REQUIRE(p != nullptr);
+		std::memset(p, 1, page_size);
+		q.commit(page_size);
+
+		auto registration = gdc::queue_registry::track(f);
+		auto total = gdc::process_memory_usage();
+
+		{
+			F g(name);
+			auto registration_g = gdc::queue_registry::track(g);
+			auto u = gdc::memory_usage(gdc::factory_region(g));
+
+			THEN("both count as queues and the shared pages are seen by each")
+			{
+				CHECK(gdc::process_memory_usage().queues == total.queues + 1);
+				CHECK(u.data_resident == page_size);
+				CHECK(u.shm_allocated >= u.control_resident + page_size);
+				CHECK(u.huge_pages == 0);
+			}
+
+			THEN("the shared memory object is counted once")
+			{
+				CHECK(gdc::process_memory_usage().shm_allocated == total.shm_allocated);
+			}
+		}
+
+		THEN("a released queue leaves the aggregate")
+		{
+			CHECK(gdc::process_memory_usage().queues == total.queues);
+		}
+
+	}
+
+}
@@ -0,0 +1,142 @@
+//
+// Copyright (c) 2016 Dado Colussi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+#include <vector>
+#include <random>
+#include <cstdint>
+#include <unistd.h>
+
+#include "catch.hpp"
+
+#if USE_C_API
+#include "gdc_circular_queue_factory.h"
+#else
+#include "gdc_circular_queue_factory.hpp"
+#endif
+
+#include "gdc_merge_reader.hpp"
+
+
+namespace
+{
+	long page_size = ::sysconf(_SC_PAGESIZE);
+}
+
+
+SCENARIO("timestamp ordered merge", "[merge]")
+{
+
+	typedef gdc::circular_queue_factory<char> F;
+	typedef typename F::value_type Q;
+	typedef gdc::framed_queue<Q> FQ;
+	typedef gdc::merge_reader<Q> M;
+
+
+	GIVEN("three stamped input queues")
+	{
+
+		F f0(16 * page_size);
+		F f1(16 * page_size);
+		F f2(16 * page_size);
+		FQ q0(f0.get(), true);
+		FQ q1(f1.get(), true);
+		FQ q2(f2.get(), true);
+		std::vector<FQ*> inputs = { &q0, &q1, &q2 };
+
+		// Records are stamped in the order they are pushed.
+		std::mt19937 rng(7);
+		const std::uint64_t n = 3000;
+		for (std::uint64_t i = 0; i < n; ++i)
+		{
+			inputs[rng() % 3]->emplace<std::uint64_t>(i);
+		}
+
+
+		WHEN("merging with a lateness bound of zero")
+		{
+			M m(inputs, 0);
+
+			THEN("records come out in timestamp order")
+			{
+				for (std::uint64_t i = 0; i < n; ++i)
+				{
+					CAPTURE(i);
+					auto h = m.peek();
+					REQUIRE(h != nullptr);
+					REQUIRE(*FQ::payload<std::uint64_t>(h) == i);
+					REQUIRE(inputs[m.source()]->peek() == h);
+					m.pop();
+				}
+
+				CHECK(m.peek() == nullptr);
+			}
+		}
+
+
+		WHEN("an input is idle and the lateness bound is long")
+		{
+			M m(inputs, 3600ull * 1000 * 1000 * 1000);
+
+			while (auto h = q2.peek())
+			{
+				(void)h;
+				q2.pop();
+			}
+
+			THEN("records newer than what the idle input returned are held back")
+			{
+				REQUIRE(m.peek() == nullptr);
+				q2.emplace<std::uint64_t>(n);
+				auto h = m.peek();
+				REQUIRE(h != nullptr);
+				CHECK(m.source() != 2);
+			}
+		}
+
+
+		WHEN("merging on a key from the payload")
+		{
+			M m(inputs, 0, [](const gdc::record_header* h)
+			{
+				return *FQ::payload<std::uint64_t>(h);
+			});
+
+			THEN("records come out in key order")
+			{
+				std::uint64_t prev = 0;
+				for (std::uint64_t i = 0; i < n; ++i)
+				{
+					auto h = m.peek();
+					REQUIRE(h != nullptr);
+					auto v = *FQ::payload<std::uint64_t>(h);
+					REQUIRE(v >= prev);
+					prev = v;
+					m.pop();
+				}
+			}
+		}
+
+	}
+
+}
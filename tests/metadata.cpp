@@ -0,0 +1,202 @@
+//
+// Copyright (c) 2016 Dado Colussi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+#include <thread>
+#include <atomic>
+#include <cstdint>
+#include <unistd.h>
+
+#include "catch.hpp"
+
+#if USE_C_API
+#include "gdc_circular_queue_factory.h"
+#else
+#include "gdc_circular_queue_factory.hpp"
+#endif
+
+#include "gdc_metadata.hpp"
+
+
+namespace
+{
+	std::string name("/gdcq.metadata_tests");
+	long page_size = ::sysconf(_SC_PAGESIZE);
+
+
+	struct config
+	{
+		std::uint64_t generation;
+		std::uint64_t values[1000];
+	};
+
+
+	config make_config(std::uint64_t generation)
+	{
+		config c;
+		c.generation = generation;
+
+		for (auto& v : c.values)
+		{
+			v = generation;
+		}
+
+		return c;
+	}
+}
+
+
+SCENARIO("typed metadata", "[metadata]")
+{
+
+	typedef gdc::circular_queue_factory<char> F;
+	typedef typename F::value_type Q;
+	typedef gdc::typed_metadata<config> M;
+
+	F::delete_shared(name);
+
+	auto mdinit = [](Q& q) -> int
+	{
+		M(q).init(make_config(1));
+		return 0;
+	};
+
+
+	GIVEN("a shared queue sized for metadata larger than a page")
+	{
+
+		REQUIRE(M::footprint > static_cast<std::size_t>(page_size));
+		F f(name, 4 * page_size, true, M::footprint, mdinit);
+		auto& q = f.get();
+
+
+		WHEN("mapping the queue from another factory")
+		{
+			F g(name);
+			auto& q2 = g.get();
+
+			THEN("the metadata size and value are visible")
+			{
+				CHECK(q2.metadata_size() >= M::footprint);
+				CHECK(q2.capacity() == q.capacity());
+				auto c = M(q2).load();
+				CHECK(c.generation == 1);
+				CHECK(c.values[999] == 1);
+			}
+		}
+
+
+		WHEN("storing a new value")
+		{
+			M(q).store(make_config(2));
+
+			THEN("readers see it and the version advances")
+			{
+				M m(q);
+				CHECK(m.load().generation == 2);
+				CHECK(m.version() == 1);
+			}
+		}
+
+
+		WHEN("using the data area")
+		{
+			std::uint32_t x = 42;
+			REQUIRE(q.push(reinterpret_cast<const char*>(&x), sizeof (x)));
+
+			THEN("data does not overlap metadata, also across the wrap")
+			{
+				auto p = q.peek();
+				CHECK(*reinterpret_cast<const std::uint32_t*>(p) == 42);
+				CHECK(p[q.capacity()] == p[0]);
+				CHECK(M(q).load().values[999] == 1);
+			}
+		}
+
+	}
+
+
+	GIVEN("a queue with the default metadata size")
+	{
+
+		F f(4 * page_size);
+		auto& q = f.get();
+
+		THEN("the metadata fills the rest of the control page")
+		{
+			CHECK(q.metadata_size() > 0);
+			CHECK(q.metadata_size() < static_cast<std::size_t>(page_size));
+			REQUIRE_THROWS_AS(M m(q), gdc::circular_queue_error&);
+		}
+
+	}
+
+
+	GIVEN("a writer updating the metadata concurrently")
+	{
+
+		F f(4 * page_size, true, M::footprint, mdinit);
+		auto& q = f.get();
+		const std::uint64_t n = 2000;
+		std::atomic<bool> done(false);
+
+		std::thread writer([&q, &done, n]()
+		{
+			M m(q);
+
+			for (std::uint64_t i = 2; i <= n; ++i)
+			{
+				m.store(make_config(i));
+				std::this_thread::yield();
+			}
+
+			done.store(true);
+		});
+
+		bool consistent = true;
+		std::uint64_t last = 0;
+		bool monotonic = true;
+		M m(q);
+
+		while (!done.load())
+		{
+			auto c = m.load();
+			consistent = consistent && c.values[0] == c.generation;
+			consistent = consistent && c.values[999] == c.generation;
+			monotonic = monotonic && c.generation >= last;
+			last = c.generation;
+			std::this_thread::yield();
+		}
+
+		writer.join();
+
+		THEN("every snapshot is consistent")
+		{
+			CHECK(consistent);
+			CHECK(monotonic);
+			CHECK(m.load().generation == n);
+		}
+
+	}
+
+}
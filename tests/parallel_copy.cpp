@@ -0,0 +1,134 @@
+//
+// Copyright (c) 2016 Dado Colussi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+
+#include <algorithm>
+#include <vector>
+#include <cstdint>
+#include <unistd.h>
+
+#include "catch.hpp"
+
+#if USE_C_API
+#include "gdc_circular_queue_factory.h"
+#else
+#include "gdc_circular_queue_factory.hpp"
+#endif
+
+#include "gdc_framed_queue.hpp"
+#include "gdc_parallel_copy.hpp"
+
+
+namespace
+{
+
+	long page_size = ::sysconf(_SC_PAGESIZE);
+
+
+	std::vector<char> pattern(std::size_t n, unsigned seed)
+	{
+		std::vector<char> v(n);
+
+		for (std::size_t i = 0; i < n; ++i)
+		{
+			v[i] = static_cast<char>((i * 31 + seed) >> 3);
+		}
+
+		return v;
+	}
+
+}
+
+
+SCENARIO("parallel copy of large records", "[parallel_copy]")
+{
+
+	GIVEN("a pool of three helpers")
+	{
+
+		gdc::copy_pool pool(3, 4096);
+		CHECK(pool.helpers() == 3);
+
+		THEN("copies of any size are exact")
+		{
+			for (std::size_t n : { 1, 100, 8191, 8192, 100000, 1 << 20, (1 << 20) + 13 })
+			{
+				auto src = pattern(n, static_cast<unsigned>(n));
+				std::vector<char> dst(n + 1, 'x');
+				pool.copy(dst.data(), src.data(), n);
+				CHECK(std::equal(src.begin(), src.end(), dst.begin()));
+				CHECK(dst[n] == 'x');
+			}
+		}
+
+		THEN("back to back copies don't mix")
+		{
+			for (unsigned i = 0; i < 50; ++i)
+			{
+				auto src = pattern(64 * 1024, i);
+				std::vector<char> dst(64 * 1024);
+				pool.copy(dst.data(), src.data(), dst.size());
+				REQUIRE(src == dst);
+			}
+		}
+
+	}
+
+
+	GIVEN("a framed queue pushing through a pool")
+	{
+
+		typedef gdc::circular_queue_factory<char> F;
+		typedef typename F::value_type Q;
+		typedef gdc::framed_queue<Q> FQ;
+
+		F f(1024 * page_size);
+		auto& q = f.get();
+		gdc::copy_pool pool(2);
+		gdc::framed_queue<Q, gdc::copy_pool_hook> producer(q, false, gdc::copy_pool_hook(pool, 1 << 20));
+		FQ consumer(q);
+		auto big = pattern(3 * 1024 * 1024 / 2, 7);
+		std::uint64_t small = 42;
+
+		REQUIRE(producer.push(&small, sizeof small));
+		REQUIRE(producer.push(big.data(), big.size(), 3));
+
+		THEN("large and small records arrive intact")
+		{
+			auto h = consumer.peek();
+			REQUIRE(h != nullptr);
+			CHECK(*FQ::payload<std::uint64_t>(h) == 42);
+			consumer.pop();
+			h = consumer.peek();
+			REQUIRE(h != nullptr);
+			REQUIRE(h->size == big.size());
+			auto p = static_cast<const char*>(FQ::payload(h));
+			CHECK(std::equal(big.begin(), big.end(), p));
+			consumer.pop();
+			CHECK(q.empty());
+		}
+
+	}
+
+}
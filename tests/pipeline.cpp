@@ -0,0 +1,171 @@
+//
+// Copyright (c) 2016 Dado Colussi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <cstdint>
+#include <sched.h>
+#include <unistd.h>
+
+#include "catch.hpp"
+
+#if USE_C_API
+#include "gdc_circular_queue_factory.h"
+#else
+#include "gdc_circular_queue_factory.hpp"
+#endif
+
+#include "gdc_pipeline.hpp"
+
+
+SCENARIO("pipeline runtime", "[pipeline]")
+{
+
+	typedef gdc::circular_queue_factory<char> F;
+	typedef gdc::pipeline<F> P;
+	typedef P::size_type size_type;
+
+
+	GIVEN("a decode -> enrich -> route pipeline")
+	{
+
+		const std::uint64_t n = 20000;
+		std::uint64_t next = 0;
+		std::atomic<std::uint64_t> received(0);
+		std::atomic<std::uint64_t> sum(0);
+		P p;
+
+		p.add_stage("decode", [&](P::stage& s) -> size_type
+		{
+			size_type k = 0;
+			while (next < n && k < 64 && s.output().emplace<std::uint64_t>(next))
+			{
+				++next;
+				++k;
+			}
+			return k;
+		}, -1, gdc::wait_mode::park);
+
+		p.add_stage("enrich", [](P::stage& s) -> size_type
+		{
+			size_type k = 0;
+			while (auto h = s.input().peek())
+			{
+				auto v = *P::framed_queue_type::payload<std::uint64_t>(h);
+				if (!s.output().emplace<std::uint64_t>(2 * v))
+				{
+					break;
+				}
+				s.input().pop();
+				++k;
+			}
+			return k;
+		}, sched_getcpu(), gdc::wait_mode::park);
+
+		p.add_stage("route", [&](P::stage& s) -> size_type
+		{
+			size_type k = 0;
+			while (auto h = s.input().peek())
+			{
+				sum += *P::framed_queue_type::payload<std::uint64_t>(h);
+				s.input().pop();
+				++received;
+				++k;
+			}
+			return k;
+		}, -1, gdc::wait_mode::park);
+
+		p.connect("decode", "enrich");
+		p.connect("enrich", "route", 4096);
+
+
+		WHEN("running until every record is routed")
+		{
+			p.start();
+
+			for (int i = 0; i < 3000 && received < n; ++i)
+			{
+				std::this_thread::sleep_for(std::chrono::milliseconds(10));
+			}
+
+			p.stop();
+
+			THEN("all records pass through every stage")
+			{
+				REQUIRE(received == n);
+				CHECK(sum == n * (n - 1));
+			}
+
+			THEN("statistics cover stages and edges")
+			{
+				auto stages = p.stage_statistics();
+				REQUIRE(stages.size() == 3);
+				CHECK(stages[0].name == "decode");
+				CHECK(stages[0].records == n);
+				CHECK(stages[2].records == n);
+				CHECK(stages[2].records_per_second > 0);
+
+				auto edges = p.edge_statistics();
+				REQUIRE(edges.size() == 2);
+				CHECK(edges[1].from == "enrich");
+				CHECK(edges[1].to == "route");
+				CHECK(edges[1].capacity == static_cast<size_type>(::sysconf(_SC_PAGESIZE)));
+				CHECK(edges[1].occupancy == 0);
+			}
+		}
+
+
+		WHEN("a stage throws")
+		{
+			p.add_stage("broken", [](P::stage&) -> size_type
+			{
+				throw gdc::circular_queue_error("broken");
+			});
+			p.start();
+
+			THEN("the pipeline stops and stop() rethrows")
+			{
+				for (int i = 0; i < 1000 && p.running(); ++i)
+				{
+					std::this_thread::sleep_for(std::chrono::milliseconds(1));
+				}
+
+				CHECK_FALSE(p.running());
+				REQUIRE_THROWS_AS(p.stop(), gdc::circular_queue_error&);
+			}
+		}
+
+
+		WHEN("connecting an unknown stage")
+		{
+			THEN("connect() throws")
+			{
+				REQUIRE_THROWS_AS(p.connect("decode", "nowhere"), gdc::circular_queue_error&);
+			}
+		}
+
+	}
+
+}
@@ -0,0 +1,217 @@
+//
+// Copyright (c) 2016 Dado Colussi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+#include <cstdint>
+#include <unistd.h>
+
+#include "catch.hpp"
+
+#if USE_C_API
+#include "gdc_circular_queue_factory.h"
+#else
+#include "gdc_circular_queue_factory.hpp"
+#endif
+
+#include "gdc_framed_queue.hpp"
+#include "gdc_rate_limiter.hpp"
+
+
+namespace
+{
+
+	long page_size = ::sysconf(_SC_PAGESIZE);
+
+
+	// Simulated time in nanoseconds, so that results don't depend on
+	// scheduling.
+	std::uint64_t now_ns = 1;
+
+
+	std::uint64_t simulated_clock()
+	{
+		return now_ns;
+	}
+
+}
+
+
+SCENARIO("token bucket rate limiting", "[rate_limiter]")
+{
+
+	typedef gdc::circular_queue_factory<char> F;
+	typedef typename F::value_type Q;
+	typedef gdc::framed_queue<Q> FQ;
+
+
+	GIVEN("a limiter of 1000 records/s with a burst of 10")
+	{
+
+		gdc::rate_limit limit;
+		limit.records_per_second = 1000;
+		limit.burst_records = 10;
+		gdc::rate_limiter limiter(limit, simulated_clock);
+
+		for (int i = 0; i < 10; ++i)
+		{
+			REQUIRE(limiter.try_acquire(100));
+		}
+
+		THEN("the burst is admitted and the next record waits")
+		{
+			CHECK_FALSE(limiter.try_acquire(100));
+			auto st = limiter.stats();
+			CHECK(st.records == 10);
+			CHECK(st.bytes == 1000);
+			CHECK(st.throttled_calls == 1);
+		}
+
+		THEN("tokens come back over time and throttled time is counted")
+		{
+			CHECK_FALSE(limiter.try_acquire(100));
+			now_ns += 500000;
+			CHECK_FALSE(limiter.try_acquire(100));
+			CHECK(limiter.stats().throttled_ns == 500000);
+			now_ns += 600000;
+			CHECK(limiter.try_acquire(100));
+			CHECK(limiter.stats().throttled_ns == 1100000);
+		}
+
+	}
+
+
+	GIVEN("a limiter of 0.5 records/s")
+	{
+
+		gdc::rate_limit limit;
+		limit.records_per_second = 0.5;
+		gdc::rate_limiter limiter(limit, simulated_clock);
+
+		THEN("one record goes through every 2 s")
+		{
+			CHECK(limiter.try_acquire(100));
+			now_ns += 1000000000;
+			CHECK_FALSE(limiter.try_acquire(100));
+			now_ns += 1000000000;
+			CHECK(limiter.try_acquire(100));
+			CHECK_FALSE(limiter.try_acquire(100));
+		}
+
+	}
+
+
+	GIVEN("a limiter of 1000 bytes/s with a burst of 100")
+	{
+
+		gdc::rate_limit limit;
+		limit.bytes_per_second = 1000;
+		limit.burst_bytes = 100;
+		gdc::rate_limiter limiter(limit, simulated_clock);
+
+		THEN("records are limited by size")
+		{
+			CHECK(limiter.try_acquire(60));
+			CHECK_FALSE(limiter.try_acquire(60));
+			CHECK(limiter.try_acquire(40));
+		}
+
+		THEN("a record larger than the burst waits for a full bucket")
+		{
+			CHECK(limiter.try_acquire(1000));
+			CHECK_FALSE(limiter.try_acquire(1000));
+		}
+
+	}
+
+
+	GIVEN("a framed queue with a rate limiter")
+	{
+
+		F f(16 * page_size);
+		auto& q = f.get();
+		gdc::rate_limit limit;
+		limit.records_per_second = 20000;
+		limit.burst_records = 5;
+		gdc::rate_limiter limiter(limit, simulated_clock);
+		gdc::framed_queue<Q, gdc::rate_limit_hook> producer(q, false, gdc::rate_limit_hook(limiter));
+
+
+		WHEN("the burst is used up")
+		{
+			for (int i = 0; i < 5; ++i)
+			{
+				REQUIRE(producer.emplace<std::uint64_t>(i));
+			}
+
+			auto space = q.space();
+
+			THEN("alloc fails although the queue has space")
+			{
+				CHECK_FALSE(producer.emplace<std::uint64_t>(5));
+				CHECK(q.space() == space);
+			}
+		}
+
+
+		WHEN("a record is committed shorter than allocated")
+		{
+			auto p = producer.alloc(1000);
+			REQUIRE(p != nullptr);
+			producer.commit(8);
+
+			THEN("only the committed record is charged")
+			{
+				auto st = limiter.stats();
+				CHECK(st.records == 1);
+				CHECK(st.bytes == FQ::footprint(8));
+			}
+		}
+
+
+		WHEN("pushing every microsecond for 50 ms")
+		{
+			FQ consumer(q);
+			std::uint64_t n = 0;
+
+			for (int i = 0; i < 50000; ++i)
+			{
+				now_ns += 1000;
+
+				if (producer.emplace<std::uint64_t>(n))
+				{
+					++n;
+					consumer.pop();
+				}
+			}
+
+			THEN("the burst and 20 records per ms go through")
+			{
+				CHECK(n >= 1004);
+				CHECK(n <= 1005);
+				CHECK(limiter.stats().throttled_calls == 50000 - n);
+			}
+		}
+
+	}
+
+}
@@ -0,0 +1,381 @@
+//
+// Copyright (c) 2016 Dado Colussi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#include "gdc_circular_queue_factory.hpp"
+#include "gdc_load_generator.hpp"
+#include "gdc_load_latency.hpp"
+#include "gdc_topology.hpp"
+#include "gdc_thread.hpp"
+
+
+// Runs K producer/consumer pairs at once, each on its own private queue,
+// for K = 1, 2, 4... up to --pairs, without and with a noisy neighbour
+// streaming memory. Reports aggregate flat-out throughput, scaling
+// efficiency against K times the quiet single pair, and per-pair tail latency
+// at --rate records/s per pair.
+//
+// Usage: scaling_bench [options]
+//   --pairs K          largest number of pairs (default 4)
+//   --cpus LIST        CPUs for pair i: producer LIST[2i], consumer
+//                      LIST[2i+1]; unpinned beyond the list (default none)
+//   --noise-cpus LIST  CPUs of the noisy neighbour threads (default one
+//                      unpinned thread)
+//   --noise-mb N       buffer streamed by each noise thread (default 256)
+//   --rate N           records/s per pair for latency (default 100000)
+//   --size N           payload bytes (default 64)
+//   --capacity N       queue capacity in bytes (default 256 KiB)
+//   --ms N             duration of each run (default 200)
+
+
+namespace
+{
+
+	typedef gdc::circular_queue_factory<char> F;
+	typedef typename F::value_type Q;
+	typedef gdc::framed_queue<Q> FQ;
+
+
+	struct config
+	{
+		std::size_t pairs;
+		std::vector<int> cpus;
+		std::vector<int> noise_cpus;
+		std::size_t noise_bytes;
+		double rate;
+		std::size_t size;
+		std::size_t capacity;
+		std::uint64_t duration_ns;
+	};
+
+
+	struct pair_result
+	{
+		double achieved;
+		std::vector<std::uint64_t> latencies;
+	};
+
+
+	struct run_result
+	{
+		std::vector<pair_result> pairs;
+		double noise_bytes_per_second;
+	};
+
+
+	// Throws if a CPU of the list is not available. Checked before any
+	// thread starts, since pin() cannot report errors from inside one.
+	void check_cpus(const std::vector<int>& cpus)
+	{
+		for (auto cpu : cpus)
+		{
+			if (!gdc::can_pin_current_thread(cpu))
+			{
+				throw gdc::circular_queue_error("CPU " + std::to_string(cpu) + " is not available");
+			}
+		}
+	}
+
+
+	void pin(const std::vector<int>& cpus, std::size_t i)
+	{
+		if (i < cpus.size())
+		{
+			gdc::pin_current_thread(cpus[i]);
+		}
+	}
+
+
+	// Copies between the halves of a buffer larger than the last level
+	// cache from go until stop is set. Returns bytes copied.
+	std::uint64_t stream(
+		std::size_t nbytes,
+		std::atomic<std::size_t>& ready,
+		const std::atomic<bool>& go,
+		const std::atomic<bool>& stop)
+	{
+		std::vector<char> buffer(nbytes, 1);
+		auto half = nbytes / 2;
+		std::uint64_t copied = 0;
+		++ready;
+
+		while (!go.load(std::memory_order_acquire))
+		{
+			std::this_thread::yield();
+		}
+
+		while (!stop.load(std::memory_order_relaxed))
+		{
+			std::memcpy(buffer.data() + half, buffer.data(), half);
+			copied += half;
+		}
+
+		return copied;
+	}
+
+
+	// Pairs send flat out if rate is 0.
+	run_result run(const config& c, std::size_t k, double rate, bool noisy)
+	{
+		std::vector<std::unique_ptr<F>> factories;
+		run_result result;
+		result.pairs.resize(k);
+		std::atomic<bool> go(false);
+		std::atomic<bool> done(false);
+		std::atomic<bool> quiet(false);
+		std::atomic<std::uint64_t> noise_copied(0);
+		std::atomic<std::size_t> noise_ready(0);
+		std::vector<std::thread> consumers;
+		std::vector<std::thread> producers;
+		std::vector<std::thread> noise;
+
+		for (std::size_t i = 0; i < k; ++i)
+		{
+			factories.emplace_back(new F(c.capacity));
+		}
+
+		auto noise_threads = noisy ? std::max<std::size_t>(c.noise_cpus.size(), 1) : 0;
+		for (std::size_t i = 0; i < noise_threads; ++i)
+		{
+			noise.emplace_back([&, i]()
+			{
+				pin(c.noise_cpus, i);
+				noise_copied += stream(c.noise_bytes, noise_ready, go, quiet);
+			});
+		}
+
+		for (std::size_t i = 0; i < k; ++i)
+		{
+			auto& q = factories[i]->get();
+			auto& r = result.pairs[i];
+			r.latencies.reserve(rate > 0 ? static_cast<std::size_t>(rate * c.duration_ns / 1e9 * 1.1) : 1 << 20);
+
+			consumers.emplace_back([&, i]()
+			{
+				pin(c.cpus, 2 * i + 1);
+				gdc::drain_load(q, done, r.latencies);
+			});
+
+			producers.emplace_back([&, i]()
+			{
+				pin(c.cpus, 2 * i);
+				FQ fq(q);
+				gdc::load_options o;
+				o.sizes = gdc::size_distribution::fixed(c.size);
+				o.records_per_second = rate;
+				o.duration_ns = c.duration_ns;
+				o.seed = i + 1;
+				gdc::load_generator<Q> generator(fq, o);
+
+				while (!go.load(std::memory_order_acquire))
+				{
+					std::this_thread::yield();
+				}
+
+				r.achieved = generator.run().records_per_second();
+			});
+		}
+
+		while (noise_ready < noise_threads)
+		{
+			std::this_thread::yield();
+		}
+
+		auto start = gdc::clock_ns();
+		go.store(true, std::memory_order_release);
+
+		for (auto& t : producers)
+		{
+			t.join();
+		}
+
+		done.store(true, std::memory_order_release);
+
+		for (auto& t : consumers)
+		{
+			t.join();
+		}
+
+		quiet.store(true);
+
+		for (auto& t : noise)
+		{
+			t.join();
+		}
+
+		auto elapsed = gdc::clock_ns() - start;
+		result.noise_bytes_per_second = noise_copied * 1e9 / elapsed;
+		return result;
+	}
+
+
+	void usage()
+	{
+		std::cerr
+			<< "Usage: scaling_bench [--pairs K] [--cpus LIST] [--noise-cpus LIST] [--noise-mb N]" << std::endl
+			<< "                     [--rate N] [--size N] [--capacity N] [--ms N]" << std::endl;
+	}
+
+}
+
+
+int
+main(int argc, char* argv[])
+{
+	config c;
+	c.pairs = 4;
+	c.noise_bytes = 256 << 20;
+	c.rate = 100000;
+	c.size = 64;
+	c.capacity = 256 << 10;
+	c.duration_ns = 200000000;
+
+	try
+	{
+		for (int i = 1; i < argc; ++i)
+		{
+			std::string a = argv[i];
+
+			if (i + 1 == argc)
+			{
+				usage();
+				return EXIT_FAILURE;
+			}
+
+			std::string v = argv[++i];
+
+			if (a == "--pairs")
+			{
+				c.pairs = std::stoul(v);
+			}
+			else if (a == "--cpus")
+			{
+				c.cpus = gdc::parse_cpu_list(v);
+			}
+			else if (a == "--noise-cpus")
+			{
+				c.noise_cpus = gdc::parse_cpu_list(v);
+			}
+			else if (a == "--noise-mb")
+			{
+				c.noise_bytes = std::stoul(v) << 20;
+			}
+			else if (a == "--rate")
+			{
+				c.rate = std::stod(v);
+			}
+			else if (a == "--size")
+			{
+				c.size = std::stoul(v);
+			}
+			else if (a == "--capacity")
+			{
+				c.capacity = std::stoul(v);
+			}
+			else if (a == "--ms")
+			{
+				c.duration_ns = std::stoull(v) * 1000000;
+			}
+			else
+			{
+				usage();
+				return EXIT_FAILURE;
+			}
+		}
+
+		check_cpus(c.cpus);
+		check_cpus(c.noise_cpus);
+
+		std::cout
+			<< std::thread::hardware_concurrency() << " CPUs, payload " << c.size
+			<< " B, capacity " << c.capacity << " B, latency at " << std::fixed << std::setprecision(0)
+			<< c.rate << " records/s per pair, in us" << std::endl
+			<< "pairs  noise   aggregate/s  efficiency  p99 median  p99 worst  p99.9 worst  noise GB/s" << std::endl;
+
+		double single = 0;
+
+		for (auto noisy : { false, true })
+		{
+			for (std::size_t k = 1; k <= c.pairs; k *= 2)
+			{
+				auto throughput = run(c, k, 0, noisy);
+				double aggregate = 0;
+
+				for (auto& p : throughput.pairs)
+				{
+					aggregate += p.achieved;
+				}
+
+				// Efficiency is against the quiet single pair, so it also
+				// shows the cost of the neighbour.
+				if (k == 1 && !noisy)
+				{
+					single = aggregate;
+				}
+
+				auto latency = run(c, k, c.rate, noisy);
+				std::vector<double> p99;
+				double p999 = 0;
+
+				for (auto& p : latency.pairs)
+				{
+					p99.push_back(gdc::latency_percentile(p.latencies, 0.99) / 1e3);
+					p999 = std::max(p999, gdc::latency_percentile(p.latencies, 0.999) / 1e3);
+				}
+
+				std::sort(p99.begin(), p99.end());
+				std::cout
+					<< std::setw(5) << k
+					<< std::setw(7) << (noisy ? "on" : "off")
+					<< std::setprecision(0) << std::setw(14) << aggregate
+					<< std::setprecision(2) << std::setw(12) << aggregate / (k * single)
+					<< std::setprecision(1)
+					<< std::setw(12) << p99[p99.size() / 2]
+					<< std::setw(11) << p99.back()
+					<< std::setw(13) << p999
+					<< std::setprecision(2) << std::setw(12) << throughput.noise_bytes_per_second / 1e9
+					<< std::endl;
+			}
+		}
+	}
+	catch (const std::exception& ex)
+	{
+		std::cerr << ex.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
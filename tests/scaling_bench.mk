@@ -0,0 +1,5 @@
+TARGET := scaling_bench
+TGT_INCDIRS := ../src
+TGT_DEFS :=
+TGT_CXXFLAGS := -O2
+SOURCES := scaling_bench.cpp
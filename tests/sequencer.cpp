@@ -0,0 +1,144 @@
+//
+// Copyright (c) 2016 Dado Colussi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+#include <vector>
+#include <thread>
+#include <future>
+#include <algorithm>
+#include <cstdint>
+#include <unistd.h>
+
+#include "catch.hpp"
+
+#if USE_C_API
+#include "gdc_circular_queue_factory.h"
+#else
+#include "gdc_circular_queue_factory.hpp"
+#endif
+
+#include "gdc_framed_queue.hpp"
+#include "gdc_sequencer.hpp"
+
+
+namespace
+{
+	long page_size = ::sysconf(_SC_PAGESIZE);
+}
+
+
+SCENARIO("global sequencer", "[sequencer]")
+{
+
+	typedef gdc::circular_queue_factory<char> F;
+	typedef typename F::value_type Q;
+	typedef gdc::framed_queue<Q> FQ;
+
+
+	GIVEN("producers sharing a sequencer in queue metadata")
+	{
+
+		F mdf(page_size);
+		auto s = gdc::make_metadata_sequencer(mdf.get());
+		REQUIRE(reinterpret_cast<std::uintptr_t>(s) % LEVEL1_DCACHE_LINESIZE == 0);
+
+		const int producers = 4;
+		const int n = 10000;
+
+
+		for (std::uint64_t batch : { 1, 16 })
+		{
+			WHEN("producers take batches of " + std::to_string(batch))
+			{
+				std::vector<std::unique_ptr<F>> factories;
+				std::vector<std::future<std::vector<std::uint64_t>>> results;
+
+				for (int p = 0; p < producers; ++p)
+				{
+					factories.emplace_back(new F(64 * page_size));
+					auto& q = factories.back()->get();
+
+					results.push_back(std::async(std::launch::async, [&q, s, batch, n]()
+					{
+						gdc::sequence_source src(*s, batch);
+						gdc::framed_queue<Q, gdc::sequence_hook> fq(q, false, gdc::sequence_hook(src));
+						std::vector<std::uint64_t> seen;
+
+						for (int i = 0; i < n; ++i)
+						{
+							fq.emplace<int>(i);
+							seen.push_back(fq.peek()->sequence);
+							fq.pop();
+						}
+
+						return seen;
+					}));
+				}
+
+				std::vector<std::uint64_t> all;
+				bool increasing = true;
+
+				for (auto& r : results)
+				{
+					auto seen = r.get();
+					increasing = increasing && std::is_sorted(seen.begin(), seen.end());
+					all.insert(all.end(), seen.begin(), seen.end());
+				}
+
+				THEN("sequence numbers are unique and increase per producer")
+				{
+					CHECK(increasing);
+					std::sort(all.begin(), all.end());
+					CHECK(std::adjacent_find(all.begin(), all.end()) == all.end());
+					CHECK(all.front() >= 1);
+				}
+
+				THEN("without batching the numbers are dense")
+				{
+					if (batch == 1)
+					{
+						std::sort(all.begin(), all.end());
+						CHECK(all.back() - all.front() + 1 == all.size());
+					}
+				}
+			}
+		}
+
+	}
+
+
+	GIVEN("a framed queue without a sequence source")
+	{
+
+		F f(page_size);
+		FQ fq(f.get());
+		fq.emplace<int>(1);
+
+		THEN("records are unsequenced")
+		{
+			CHECK(fq.peek()->sequence == 0);
+		}
+
+	}
+
+}
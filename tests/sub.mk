@@ -3,3 +3,12 @@ SUBMAKEFILES :=\
   cpp_impl_test.mk\
   ping.mk\
   pong.mk\
+  codec_bench.mk\
+  topology.mk\
+  layout_bench_64.mk\
+  layout_bench_128.mk\
+  layout_bench_page.mk\
+  load_gen.mk\
+  latency_bench.mk\
+  scaling_bench.mk\
+  wait_bench.mk
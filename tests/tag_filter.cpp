@@ -0,0 +1,169 @@
+//
+// Copyright (c) 2016 Dado Colussi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+
+#include <cstdint>
+#include <unistd.h>
+
+#include "catch.hpp"
+
+#if USE_C_API
+#include "gdc_circular_queue_factory.h"
+#else
+#include "gdc_circular_queue_factory.hpp"
+#endif
+
+#include "gdc_framed_queue.hpp"
+
+
+namespace
+{
+	long page_size = ::sysconf(_SC_PAGESIZE);
+}
+
+
+SCENARIO("tag filtered reading", "[tag_filter]")
+{
+
+	typedef gdc::circular_queue_factory<char> F;
+	typedef typename F::value_type Q;
+	typedef gdc::framed_queue<Q> FQ;
+
+	F f(4 * page_size);
+	auto& q = f.get();
+	FQ producer(q);
+	FQ consumer(q);
+
+
+	GIVEN("a tag filter")
+	{
+
+		gdc::tag_filter filter;
+		filter.add(7).add(64).add(65535);
+
+		THEN("it holds the added tags only")
+		{
+			CHECK(filter.contains(7));
+			CHECK(filter.contains(64));
+			CHECK(filter.contains(65535));
+			CHECK_FALSE(filter.contains(0));
+			CHECK_FALSE(filter.contains(63));
+			filter.remove(64);
+			CHECK_FALSE(filter.contains(64));
+		}
+
+	}
+
+
+	GIVEN("a stream where every 20th record is wanted")
+	{
+
+		gdc::tag_filter filter;
+		filter.add(5);
+
+		// Several laps of the queue, so that scans cross its end.
+		const std::uint64_t n = 2000;
+		std::uint64_t sent = 0;
+		std::uint64_t received = 0;
+		std::uint64_t wrong = 0;
+
+		while (received < n / 20)
+		{
+			while (sent < n && producer.push(&sent, sizeof sent, sent % 20 == 19 ? 5 : 1))
+			{
+				++sent;
+			}
+
+			const gdc::record_header* h;
+
+			while ((h = consumer.peek_matching(filter)) != nullptr)
+			{
+				auto v = *FQ::payload<std::uint64_t>(h);
+				wrong += h->tag != 5 || v % 20 != 19;
+				++received;
+				consumer.pop();
+			}
+		}
+
+		THEN("only the wanted records are returned and the rest is released")
+		{
+			CHECK(wrong == 0);
+			CHECK(received == n / 20);
+			CHECK(consumer.records_popped() == received);
+			CHECK(consumer.records_skipped() == n - received);
+			CHECK(q.empty());
+		}
+
+	}
+
+
+	GIVEN("unwanted records only")
+	{
+
+		gdc::tag_filter filter;
+		filter.add(9);
+
+		for (std::uint64_t i = 0; i < 10; ++i)
+		{
+			REQUIRE(producer.push(&i, sizeof i, 1));
+		}
+
+		THEN("one call removes them all")
+		{
+			CHECK(consumer.peek_matching(filter) == nullptr);
+			CHECK(consumer.records_skipped() == 10);
+			CHECK(q.empty());
+		}
+
+	}
+
+
+	GIVEN("a release batch")
+	{
+
+		consumer.set_release_batch(100);
+		gdc::tag_filter filter;
+		filter.add(2);
+
+		for (std::uint64_t i = 0; i < 10; ++i)
+		{
+			REQUIRE(producer.push(&i, sizeof i, i == 5 ? 2 : 1));
+		}
+
+		auto used = q.available();
+
+		THEN("skipped space is held back with popped space")
+		{
+			auto h = consumer.peek_matching(filter);
+			REQUIRE(h != nullptr);
+			CHECK(*FQ::payload<std::uint64_t>(h) == 5);
+			CHECK(q.available() == used);
+			consumer.pop();
+			CHECK(consumer.peek_matching(filter) == nullptr);
+			CHECK(q.empty());
+		}
+
+	}
+
+}
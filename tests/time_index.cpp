@@ -0,0 +1,149 @@
+//
+// Copyright (c) 2016 Dado Colussi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+#include <cstdint>
+#include <unistd.h>
+
+#include "catch.hpp"
+
+#if USE_C_API
+#include "gdc_circular_queue_factory.h"
+#else
+#include "gdc_circular_queue_factory.hpp"
+#endif
+
+#include "gdc_framed_queue.hpp"
+#include "gdc_time_index.hpp"
+
+
+namespace
+{
+	long page_size = ::sysconf(_SC_PAGESIZE);
+}
+
+
+SCENARIO("skipping expired records", "[expiry]")
+{
+
+	typedef gdc::circular_queue_factory<char> F;
+	typedef typename F::value_type Q;
+	typedef gdc::framed_queue<Q> FQ;
+
+
+	GIVEN("a stamped queue with a time index in its metadata")
+	{
+
+		F f(128 * page_size);
+		auto& q = f.get();
+		auto index = new (q.metadata()) gdc::time_index();
+		index->init();
+
+		gdc::framed_queue<Q, gdc::time_index_hook> producer(q, true, gdc::time_index_hook(*index));
+		FQ consumer(q);
+
+		const std::uint32_t n = 10000;
+		std::uint64_t deadline1000 = 0;
+		std::uint64_t deadline7000 = 0;
+
+		for (std::uint32_t i = 0; i < n; ++i)
+		{
+			if (i == 1000)
+			{
+				deadline1000 = gdc::clock_ns();
+			}
+
+			if (i == 7000)
+			{
+				deadline7000 = gdc::clock_ns();
+			}
+
+			REQUIRE(producer.emplace<std::uint32_t>(i));
+		}
+
+
+		WHEN("skipping records older than a recent deadline")
+		{
+			auto skipped = gdc::skip_older_than(consumer, *index, deadline7000);
+
+			THEN("the first record is the first one at or after the deadline")
+			{
+				auto h = consumer.peek();
+				REQUIRE(h != nullptr);
+				CHECK(*FQ::payload<std::uint32_t>(h) == 7000);
+				CHECK(skipped == 7000 * FQ::footprint(sizeof (std::uint32_t)));
+			}
+		}
+
+
+		WHEN("the deadline is older than the index reaches")
+		{
+			gdc::skip_older_than(consumer, *index, deadline1000);
+
+			THEN("records are skipped one by one up to the deadline")
+			{
+				auto h = consumer.peek();
+				REQUIRE(h != nullptr);
+				CHECK(*FQ::payload<std::uint32_t>(h) == 1000);
+			}
+		}
+
+
+		WHEN("every record is expired")
+		{
+			gdc::skip_older_than(consumer, *index, gdc::clock_ns());
+
+			THEN("the queue is empty")
+			{
+				CHECK(consumer.empty());
+			}
+		}
+
+
+		WHEN("skipping in steps while the queue wraps")
+		{
+			for (std::uint32_t i = 0; i < 3; ++i)
+			{
+				gdc::skip_older_than(consumer, *index, gdc::clock_ns());
+
+				for (std::uint32_t j = 0; j < n; ++j)
+				{
+					REQUIRE(producer.emplace<std::uint32_t>(j));
+				}
+			}
+
+			auto deadline = gdc::clock_ns();
+			REQUIRE(producer.emplace<std::uint32_t>(n));
+
+			THEN("stale index entries from earlier laps are ignored")
+			{
+				gdc::skip_older_than(consumer, *index, deadline);
+				auto h = consumer.peek();
+				REQUIRE(h != nullptr);
+				CHECK(*FQ::payload<std::uint32_t>(h) == n);
+			}
+		}
+
+	}
+
+}
@@ -0,0 +1,295 @@
+//
+// Copyright (c) 2016 Dado Colussi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <cstdint>
+#include <cstdlib>
+
+#include "gdc_circular_queue_factory.hpp"
+#include "gdc_topology.hpp"
+#include "gdc_thread.hpp"
+
+
+// Prints the CPU topology, a one-way latency matrix measured by ping-pong
+// over private queues, and recommended producer/consumer placements.
+//
+// Usage: topology [round trips per pair] [max cpus]
+
+
+namespace
+{
+
+	typedef gdc::circular_queue_factory<std::uint64_t> F;
+	typedef typename F::value_type Q;
+	typedef std::chrono::steady_clock clock;
+
+
+	const std::size_t capacity = 4096;
+	const std::uint64_t stop = ~std::uint64_t(0);
+
+
+	void echo(Q& in, Q& out, int cpu)
+	{
+		gdc::pin_current_thread(cpu);
+
+		for (;;)
+		{
+			auto p = in.peek();
+
+			if (p == nullptr)
+			{
+				continue;
+			}
+
+			auto v = *p;
+			in.pop(sizeof v);
+
+			if (v == stop)
+			{
+				return;
+			}
+
+			while (!out.push(v))
+			{
+			}
+		}
+	}
+
+
+	// Returns the median over batches of the one-way latency in ns.
+	double ping(Q& out, Q& in, int cpu, std::uint64_t round_trips)
+	{
+		gdc::pin_current_thread(cpu);
+		const int batches = 9;
+		std::vector<double> results;
+		auto per_batch = std::max<std::uint64_t>(round_trips / batches, 1);
+		std::uint64_t seq = 0;
+
+		for (int b = -1; b < batches; ++b)
+		{
+			auto t0 = clock::now();
+
+			for (std::uint64_t i = 0; i < per_batch; ++i)
+			{
+				out.push(++seq);
+				const std::uint64_t* p;
+
+				while ((p = in.peek()) == nullptr)
+				{
+				}
+
+				in.pop(sizeof *p);
+			}
+
+			std::chrono::duration<double, std::nano> d = clock::now() - t0;
+
+			// Batch -1 warms up caches and frequency.
+			if (b >= 0)
+			{
+				results.push_back(d.count() / per_batch / 2);
+			}
+		}
+
+		out.push(stop);
+		std::sort(results.begin(), results.end());
+		return results[results.size() / 2];
+	}
+
+
+	double measure(int a, int b, std::uint64_t round_trips)
+	{
+		F f1(capacity);
+		F f2(capacity);
+		auto& q1 = f1.get();
+		auto& q2 = f2.get();
+		double latency = 0;
+		std::thread consumer(echo, std::ref(q1), std::ref(q2), b);
+		std::thread producer([&]() { latency = ping(q1, q2, a, round_trips); });
+		producer.join();
+		consumer.join();
+		return latency;
+	}
+
+
+	void print_topology(const std::vector<gdc::cpu_info>& cpus)
+	{
+		auto list = [](const std::vector<int>& v)
+		{
+			std::string s;
+
+			for (auto c : v)
+			{
+				s += (s.empty() ? "" : ",") + std::to_string(c);
+			}
+
+			return s;
+		};
+
+		std::cout << "cpu  core  package  die  smt siblings  L2 sharers  LLC sharers" << std::endl;
+
+		for (auto& c : cpus)
+		{
+			std::cout
+				<< std::setw(3) << c.cpu
+				<< std::setw(6) << c.core
+				<< std::setw(9) << c.package
+				<< std::setw(5) << c.die
+				<< "  " << std::setw(12) << list(c.smt_siblings)
+				<< "  " << std::setw(10) << list(c.l2_sharers)
+				<< "  " << list(c.llc_sharers) << std::endl;
+		}
+	}
+
+
+	struct pair_result
+	{
+		int producer;
+		int consumer;
+		gdc::cpu_relation relation;
+		double latency;
+	};
+
+}
+
+
+int
+main(int argc, char* argv[])
+{
+	std::uint64_t round_trips = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 90000;
+	std::size_t max_cpus = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 16;
+
+	try
+	{
+		auto cpus = gdc::read_cpu_topology();
+		print_topology(cpus);
+
+		if (cpus.size() > max_cpus)
+		{
+			std::cout << "Measuring the first " << max_cpus << " CPUs only." << std::endl;
+			cpus.resize(max_cpus);
+		}
+
+		if (cpus.size() < 2)
+		{
+			std::cout << "Fewer than two online CPUs, nothing to measure." << std::endl;
+			return EXIT_SUCCESS;
+		}
+
+		std::vector<pair_result> results;
+		std::cout << std::endl << "One-way latency (ns), producer rows, consumer columns" << std::endl;
+		std::cout << "     ";
+
+		for (auto& c : cpus)
+		{
+			std::cout << std::setw(7) << c.cpu;
+		}
+
+		std::cout << std::endl;
+
+		for (auto& a : cpus)
+		{
+			std::cout << std::setw(5) << a.cpu;
+
+			for (auto& b : cpus)
+			{
+				if (a.cpu == b.cpu)
+				{
+					std::cout << std::setw(7) << "-";
+					continue;
+				}
+
+				pair_result r;
+				r.producer = a.cpu;
+				r.consumer = b.cpu;
+				r.relation = gdc::relation(a, b);
+				r.latency = measure(a.cpu, b.cpu, round_trips);
+				results.push_back(r);
+				std::cout << std::setw(7) << std::fixed << std::setprecision(0) << r.latency << std::flush;
+			}
+
+			std::cout << std::endl;
+		}
+
+		std::map<gdc::cpu_relation, std::vector<double>> by_relation;
+
+		for (auto& r : results)
+		{
+			by_relation[r.relation].push_back(r.latency);
+		}
+
+		std::cout << std::endl << "By relation (ns): min / median / max" << std::endl;
+
+		for (auto& kv : by_relation)
+		{
+			auto& v = kv.second;
+			std::sort(v.begin(), v.end());
+			std::cout
+				<< "  " << std::setw(13) << std::left << gdc::to_string(kv.first) << std::right
+				<< std::setw(7) << v.front()
+				<< std::setw(7) << v[v.size() / 2]
+				<< std::setw(7) << v.back() << std::endl;
+		}
+
+		auto by_latency = [](const pair_result& x, const pair_result& y)
+		{
+			return x.latency < y.latency;
+		};
+
+		std::sort(results.begin(), results.end(), by_latency);
+		std::cout << std::endl << "Recommended placements" << std::endl;
+		auto& best = results.front();
+		std::cout
+			<< "  lowest latency: producer " << best.producer
+			<< ", consumer " << best.consumer
+			<< " (" << gdc::to_string(best.relation) << ", " << best.latency << " ns)" << std::endl;
+
+		// SMT siblings share execution units with the other busy-polling
+		// thread, so also suggest the best pair on distinct cores.
+		for (auto& r : results)
+		{
+			if (r.relation != gdc::cpu_relation::smt_sibling)
+			{
+				std::cout
+					<< "  separate cores: producer " << r.producer
+					<< ", consumer " << r.consumer
+					<< " (" << gdc::to_string(r.relation) << ", " << r.latency << " ns)" << std::endl;
+				break;
+			}
+		}
+	}
+	catch (const std::exception& ex)
+	{
+		std::cerr << ex.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,5 @@
+TARGET := topology
+TGT_INCDIRS := ../src
+TGT_DEFS :=
+TGT_CXXFLAGS := -O2
+SOURCES := topology.cpp
@@ -0,0 +1,210 @@
+//
+// Copyright (c) 2016 Dado Colussi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <cstdint>
+#include <cstdlib>
+#include <time.h>
+
+#include "gdc_circular_queue_factory.hpp"
+#include "gdc_load_generator.hpp"
+#include "gdc_load_latency.hpp"
+#include "gdc_wait_strategy.hpp"
+
+
+// Consumer CPU cost and latency of each wait strategy at several message
+// rates, and CPU burnt while the queue stays idle. Latency runs from the
+// scheduled send time to receipt.
+//
+// Usage: wait_bench [ms per run] [rate...]
+
+
+namespace
+{
+
+	typedef gdc::circular_queue_factory<char> F;
+	typedef typename F::value_type Q;
+	typedef gdc::framed_queue<Q> FQ;
+
+
+	struct run_result
+	{
+		std::uint64_t records;
+		std::uint64_t dropped;
+		std::uint64_t max_lag_ns;
+		std::uint64_t cpu_ns;
+		std::uint64_t elapsed_ns;
+		std::vector<std::uint64_t> latencies;
+	};
+
+
+	std::uint64_t thread_cpu_ns()
+	{
+		timespec ts;
+		::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+		return static_cast<std::uint64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+	}
+
+
+	// Rate 0 sends nothing and measures the idle consumer.
+	template<typename W>
+	run_result run(W& w, double rate, std::uint64_t duration_ns)
+	{
+		F f(1 << 20);
+		auto& q = f.get();
+		std::atomic<bool> stop(false);
+		run_result result;
+		result.records = 0;
+		result.dropped = 0;
+		result.max_lag_ns = 0;
+		result.latencies.reserve(static_cast<std::size_t>(rate * duration_ns / 1e9 * 1.1));
+
+		std::thread consumer([&]()
+		{
+			FQ fq(q);
+			auto t0 = thread_cpu_ns();
+
+			for (;;)
+			{
+				w.wait([&]() { return !fq.empty() || stop.load(std::memory_order_acquire); });
+				const gdc::record_header* h;
+
+				while ((h = fq.peek()) != nullptr)
+				{
+					result.latencies.push_back(gdc::load_latency<Q>(h));
+					fq.pop();
+				}
+
+				if (stop.load(std::memory_order_acquire) && fq.empty())
+				{
+					break;
+				}
+			}
+
+			result.cpu_ns = thread_cpu_ns() - t0;
+		});
+
+		auto start = gdc::clock_ns();
+
+		if (rate > 0)
+		{
+			FQ fq(q);
+			gdc::load_options o;
+			o.records_per_second = rate;
+			o.duration_ns = duration_ns;
+			o.sent = [&w]() { w.notify(); };
+			gdc::load_generator<Q> generator(fq, o);
+			auto r = generator.run();
+			result.records = r.records;
+			result.dropped = r.dropped;
+			result.max_lag_ns = r.max_lag_ns;
+		}
+		else
+		{
+			std::this_thread::sleep_for(std::chrono::nanoseconds(duration_ns));
+		}
+
+		result.elapsed_ns = gdc::clock_ns() - start;
+		stop.store(true, std::memory_order_release);
+		w.notify();
+		consumer.join();
+		return result;
+	}
+
+
+	template<typename W>
+	void report(const char* name, W& w, const std::vector<double>& rates, std::uint64_t duration_ns)
+	{
+		auto idle = run(w, 0, duration_ns);
+		std::cout << std::fixed << std::setprecision(1)
+			<< std::setw(8) << name
+			<< std::setw(11) << "idle"
+			<< std::setw(11) << "-"
+			<< std::setw(9) << 100.0 * idle.cpu_ns / idle.elapsed_ns << std::endl;
+
+		for (auto rate : rates)
+		{
+			auto r = run(w, rate, duration_ns);
+			std::cout
+				<< std::setw(8) << name
+				<< std::setprecision(0) << std::setw(11) << rate
+				<< std::setprecision(1)
+				<< std::setw(11) << (r.records ? r.cpu_ns / 1e6 / (r.records / 1e6) : 0)
+				<< std::setw(9) << 100.0 * r.cpu_ns / r.elapsed_ns
+				<< std::setw(9) << gdc::latency_percentile(r.latencies, 0.5) / 1e3
+				<< std::setw(9) << gdc::latency_percentile(r.latencies, 0.99) / 1e3
+				<< std::setw(9) << gdc::latency_percentile(r.latencies, 0.999) / 1e3
+				<< std::setw(9) << r.dropped
+				<< std::setw(9) << r.max_lag_ns / 1e3 << std::endl;
+		}
+	}
+
+}
+
+
+int
+main(int argc, char* argv[])
+{
+	std::uint64_t duration_ns = (argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 500) * 1000000;
+	std::vector<double> rates;
+
+	for (int i = 2; i < argc; ++i)
+	{
+		rates.push_back(std::strtod(argv[i], nullptr));
+	}
+
+	if (rates.empty())
+	{
+		rates = { 1000, 10000, 100000, 1000000 };
+	}
+
+	try
+	{
+		std::cout
+			<< "Consumer CPU in ms per million records and % of a core, latency in us" << std::endl
+			<< "strategy       rate  ms/Mrec     cpu%      p50      p99    p99.9  dropped  max lag" << std::endl;
+
+		gdc::spin_wait spin;
+		report("spin", spin, rates, duration_ns);
+		gdc::backoff_wait backoff;
+		report("backoff", backoff, rates, duration_ns);
+		gdc::futex_wait futex;
+		report("futex", futex, rates, duration_ns);
+		gdc::eventfd_wait eventfd;
+		report("eventfd", eventfd, rates, duration_ns);
+	}
+	catch (const std::exception& ex)
+	{
+		std::cerr << ex.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,5 @@
+TARGET := wait_bench
+TGT_INCDIRS := ../src
+TGT_DEFS :=
+TGT_CXXFLAGS := -O2
+SOURCES := wait_bench.cpp
@@ -0,0 +1,174 @@
+//
+// Copyright (c) 2016 Dado Colussi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <time.h>
+#include <unistd.h>
+
+#include "catch.hpp"
+
+#if USE_C_API
+#include "gdc_circular_queue_factory.h"
+#else
+#include "gdc_circular_queue_factory.hpp"
+#endif
+
+#include "gdc_framed_queue.hpp"
+#include "gdc_wait_strategy.hpp"
+
+
+namespace
+{
+
+	long page_size = ::sysconf(_SC_PAGESIZE);
+
+	typedef gdc::circular_queue_factory<char> F;
+	typedef typename F::value_type Q;
+	typedef gdc::framed_queue<Q> FQ;
+
+
+	std::uint64_t thread_cpu_ns()
+	{
+		timespec ts;
+		::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+		return static_cast<std::uint64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+	}
+
+
+	// Sends n records, pausing now and then so that the consumer goes
+	// to sleep, then stops the consumer after idle_ms. Returns the
+	// records received and sets the consumer's CPU time.
+	template<typename W>
+	std::uint64_t exchange(W& w, std::uint64_t n, int idle_ms, std::uint64_t& cpu_ns)
+	{
+		F f(4 * page_size);
+		auto& q = f.get();
+		std::atomic<bool> stop(false);
+		std::uint64_t received = 0;
+
+		std::thread consumer([&]()
+		{
+			FQ fq(q);
+			auto t0 = thread_cpu_ns();
+
+			for (;;)
+			{
+				w.wait([&]() { return !fq.empty() || stop.load(std::memory_order_acquire); });
+
+				while (fq.peek() != nullptr)
+				{
+					++received;
+					fq.pop();
+				}
+
+				if (stop.load(std::memory_order_acquire) && fq.empty())
+				{
+					break;
+				}
+			}
+
+			cpu_ns = thread_cpu_ns() - t0;
+		});
+
+		FQ fq(q);
+
+		for (std::uint64_t i = 0; i < n; ++i)
+		{
+			while (!fq.emplace<std::uint64_t>(i))
+			{
+				std::this_thread::yield();
+			}
+
+			w.notify();
+
+			if (i % 100 == 0)
+			{
+				std::this_thread::sleep_for(std::chrono::microseconds(200));
+			}
+		}
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(idle_ms));
+		stop.store(true, std::memory_order_release);
+		w.notify();
+		consumer.join();
+		return received;
+	}
+
+}
+
+
+SCENARIO("wait strategies", "[wait_strategy]")
+{
+
+	std::uint64_t cpu_ns = 0;
+
+
+	GIVEN("spinning and backing off consumers")
+	{
+
+		gdc::spin_wait spin;
+		gdc::backoff_wait backoff;
+
+		THEN("every record is received and stop is seen")
+		{
+			CHECK(exchange(spin, 1000, 0, cpu_ns) == 1000);
+			CHECK(exchange(backoff, 1000, 0, cpu_ns) == 1000);
+		}
+
+	}
+
+
+	GIVEN("a futex waiting consumer")
+	{
+
+		gdc::futex_wait w(100);
+
+		THEN("every record is received and idle time costs little CPU")
+		{
+			CHECK(exchange(w, 5000, 100, cpu_ns) == 5000);
+			CHECK(cpu_ns < 50000000);
+		}
+
+	}
+
+
+	GIVEN("an eventfd waiting consumer")
+	{
+
+		gdc::eventfd_wait w(100);
+		CHECK(w.fd() >= 0);
+
+		THEN("every record is received and idle time costs little CPU")
+		{
+			CHECK(exchange(w, 5000, 100, cpu_ns) == 5000);
+			CHECK(cpu_ns < 50000000);
+		}
+
+	}
+
+}